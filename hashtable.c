@@ -9,6 +9,13 @@
 #define LOAD_FACTOR 0.75f
 #define INITIAL_SIZE 10
 
+// last shaped lookup, per thread so that readers sharing a shape don't race
+static _Thread_local struct {
+    const hash_shape_t *shape;
+    const char *key;
+    size_t slot;
+} lookup_cache;
+
 static void *safe_calloc(size_t nmemb, size_t size) {
     void *mem = calloc(nmemb, size);
 
@@ -47,26 +54,49 @@ hashtable_t *hash_init() {
     tbl->capacity = INITIAL_SIZE;
     tbl->size = 0;
     tbl->entries = safe_calloc(tbl->capacity, sizeof(entry_t));
+    tbl->shape = NULL;
+    tbl->repeats = false;
+    tbl->holes = false;
+
+    return tbl;
+}
+
+hashtable_t *hash_init_shaped(hash_shape_t *shape) {
+    hashtable_t *tbl = safe_malloc(sizeof(hashtable_t));
+    tbl->capacity = shape->capacity;
+    tbl->size = 0;
+    tbl->entries = safe_calloc(tbl->capacity, sizeof(entry_t));
+    tbl->shape = shape;
+    // a shape gives every key a distinct slot
+    tbl->repeats = false;
+    tbl->holes = false;
+    hash_shape_retain(shape);
 
     return tbl;
 }
 
 // djb2
-static size_t hash(const char *key, size_t capacity, size_t i) {
+size_t hash_key(const char *key, size_t len) {
     size_t hash = 5381;
-    int c;
 
-    while (c = *key++) {
-        hash = ((hash << 5) + hash) + c;
+    for (size_t i = 0; i < len; i++) {
+        hash = ((hash << 5) + hash) + key[i];
     }
 
-    return (hash + i) % capacity;
+    return hash;
+}
+
+static size_t hash(size_t key_hash, size_t capacity, size_t i) {
+    return (key_hash + i) % capacity;
 }
 
-static void insert_entry(entry_t *entries, entry_t *entry, size_t capacity) {
+// returns true if the probe passed the same key on its way to a free slot
+static bool insert_entry(entry_t *entries, entry_t *entry, size_t capacity) {
+    size_t key_hash = hash_key(entry->key, strlen(entry->key));
     size_t i = 0;
+    bool repeated = false;
     do {
-        size_t j = hash(entry->key, capacity, i);
+        size_t j = hash(key_hash, capacity, i);
         entry_t *cur_entry = (entries + j);
         if (!cur_entry->key || !(*(cur_entry->key))) {
             free(cur_entry->key);
@@ -74,9 +104,13 @@ static void insert_entry(entry_t *entries, entry_t *entry, size_t capacity) {
             cur_entry->value = entry->value;
             break;
         } else {
+            repeated |= *cur_entry->key == *entry->key
+                && !strcmp(cur_entry->key, entry->key);
             i++;
         }
     } while (i < capacity);
+
+    return repeated;
 }
 
 static void rehash(hashtable_t *tbl) {
@@ -92,10 +126,13 @@ static void rehash(hashtable_t *tbl) {
     free(tbl->entries);
     tbl->entries = entries;
     tbl->capacity = capacity;
+    // probe chains are contiguous again
+    tbl->holes = false;
 }
 
 void hash_insert(hashtable_t *tbl, const char *key, size_t key_size,
         void *value) {
+    hash_unshare(tbl);
     if ((tbl->size / (float) tbl->capacity) > LOAD_FACTOR) {
         rehash(tbl);
     }
@@ -106,14 +143,18 @@ void hash_insert(hashtable_t *tbl, const char *key, size_t key_size,
     entry.key[key_size] = '\0';
     entry.value = value;
 
-    insert_entry(tbl->entries, &entry, tbl->capacity);
+    // past a removal the same key may sit beyond a free slot, unseen
+    if (insert_entry(tbl->entries, &entry, tbl->capacity) || tbl->holes) {
+        tbl->repeats = true;
+    }
     tbl->size++;
 }
 
-static entry_t *_hash_search(const hashtable_t *tbl, const char *key) {
+static entry_t *_hash_search(const hashtable_t *tbl, const char *key,
+        size_t key_hash) {
     size_t i = 0;
     do {
-        size_t j = hash(key, tbl->capacity, i);
+        size_t j = hash(key_hash, tbl->capacity, i);
         entry_t *entry = (tbl->entries + j);
         if (entry->key && !strcmp(entry->key, key)) {
             return entry;
@@ -125,26 +166,188 @@ static entry_t *_hash_search(const hashtable_t *tbl, const char *key) {
     return NULL;
 }
 
+void hash_insert_shaped(hashtable_t *tbl, size_t index, void *value) {
+    entry_t *entry = (tbl->entries + tbl->shape->slots[index]);
+    entry->key = tbl->shape->keys[index];
+    entry->value = value;
+    tbl->size++;
+}
+
 void *hash_search(const hashtable_t *tbl, const char *key) {
-    return _hash_search(tbl, key)->value;
+    hash_shape_t *shape = tbl->shape;
+
+    // repeated lookups of the same key across same shaped tables, the slot
+    // is only a guess since a freed shape's address may be reused
+    if (shape && lookup_cache.shape == shape && lookup_cache.key == key
+            && lookup_cache.slot < tbl->capacity) {
+        entry_t *entry = (tbl->entries + lookup_cache.slot);
+        if (entry->key && !strcmp(entry->key, key)) {
+            return entry->value;
+        }
+    }
+
+    entry_t *entry = _hash_search(tbl, key, hash_key(key, strlen(key)));
+    if (!entry) {
+        return NULL;
+    }
+
+    if (shape) {
+        lookup_cache.shape = shape;
+        lookup_cache.key = key;
+        lookup_cache.slot = entry - tbl->entries;
+    }
+
+    return entry->value;
+}
+
+void *hash_search_hashed(const hashtable_t *tbl, const char *key,
+        size_t key_hash) {
+    entry_t *entry = _hash_search(tbl, key, key_hash);
+
+    return entry ? entry->value : NULL;
 }
 
 void *hash_remove(hashtable_t *tbl, const char *key) {
-    entry_t *entry = _hash_search(tbl, key);
-    entry->key = safe_realloc(entry->key, 1, sizeof(char));
-    entry->key = '\0';
+    hash_unshare(tbl);
+    entry_t *entry = _hash_search(tbl, key, hash_key(key, strlen(key)));
+    if (!entry) {
+        return NULL;
+    }
+
+    free(entry->key);
+    entry->key = NULL;
+    tbl->holes = true;
     void *tmp = entry->value;
     entry->value = NULL;
+    tbl->size--;
     return tmp;
 }
 
+hashtable_t *hash_clone(const hashtable_t *tbl,
+        void *(*clone_value)(const void *)) {
+    hashtable_t *clone = safe_malloc(sizeof(hashtable_t));
+    clone->capacity = tbl->capacity;
+    clone->size = tbl->size;
+    clone->entries = safe_calloc(clone->capacity, sizeof(entry_t));
+    clone->shape = NULL;
+    clone->repeats = tbl->repeats;
+    clone->holes = tbl->holes;
+
+    for (size_t i = 0; i < tbl->capacity; i++) {
+        entry_t *entry = (tbl->entries + i);
+        if (entry->key) {
+            size_t key_size = strlen(entry->key) + 1;
+            clone->entries[i].key = safe_malloc(key_size * sizeof(char));
+            memcpy(clone->entries[i].key, entry->key, key_size);
+            clone->entries[i].value = clone_value(entry->value);
+        }
+    }
+
+    return clone;
+}
+
 void hash_destroy(hashtable_t *tbl) {
     for (size_t i = 0; i < tbl->capacity; i++) {
         entry_t *entry = (tbl->entries + i);
-        free(entry->key);
+        if (!tbl->shape) {
+            free(entry->key);
+        }
         free(entry->value);
     }
 
+    if (tbl->shape) {
+        hash_shape_release(tbl->shape);
+    }
     free(tbl->entries);
     free(tbl);
 }
+
+hash_shape_t *hash_shape_create(hashtable_t *tbl, const char *const *keys,
+        const size_t *key_lens, size_t n) {
+    if (tbl->shape || n != tbl->size) {
+        return NULL;
+    }
+
+    hash_shape_t *shape = safe_malloc(sizeof(hash_shape_t));
+    shape->keys = safe_malloc(n * sizeof(char *));
+    shape->key_lens = safe_malloc(n * sizeof(size_t));
+    shape->slots = safe_malloc(n * sizeof(size_t));
+    shape->size = n;
+    shape->capacity = tbl->capacity;
+    shape->refcount = 1;
+
+    for (size_t i = 0; i < n; i++) {
+        size_t key_hash = hash_key(keys[i], key_lens[i]);
+        size_t j = 0;
+        entry_t *entry = NULL;
+        do {
+            entry = (tbl->entries + hash(key_hash, tbl->capacity, j));
+            if (entry->key && !strncmp(entry->key, keys[i], key_lens[i])
+                    && !entry->key[key_lens[i]]) {
+                break;
+            }
+            entry = NULL;
+            j++;
+        } while (j < tbl->capacity);
+
+        // every key must own a distinct slot
+        for (size_t k = 0; entry && k < i; k++) {
+            if (shape->slots[k] == (size_t) (entry - tbl->entries)) {
+                entry = NULL;
+            }
+        }
+
+        if (!entry) {
+            free(shape->keys);
+            free(shape->key_lens);
+            free(shape->slots);
+            free(shape);
+            return NULL;
+        }
+
+        shape->keys[i] = entry->key;
+        shape->key_lens[i] = key_lens[i];
+        shape->slots[i] = entry - tbl->entries;
+    }
+
+    tbl->shape = shape;
+    return shape;
+}
+
+void hash_shape_retain(hash_shape_t *shape) {
+    shape->refcount++;
+}
+
+void hash_shape_release(hash_shape_t *shape) {
+    if (--shape->refcount) {
+        return;
+    }
+
+    for (size_t i = 0; i < shape->size; i++) {
+        free(shape->keys[i]);
+    }
+
+    free(shape->keys);
+    free(shape->key_lens);
+    free(shape->slots);
+    free(shape);
+}
+
+void hash_unshare(hashtable_t *tbl) {
+    if (!tbl->shape) {
+        return;
+    }
+
+    for (size_t i = 0; i < tbl->capacity; i++) {
+        entry_t *entry = (tbl->entries + i);
+        if (entry->key) {
+            size_t key_size = strlen(entry->key) + 1;
+            char *key = safe_malloc(key_size * sizeof(char));
+            memcpy(key, entry->key, key_size);
+            entry->key = key;
+        }
+    }
+
+    hash_shape_release(tbl->shape);
+    tbl->shape = NULL;
+}
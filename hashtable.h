@@ -3,15 +3,35 @@
 #ifndef _HASHTABLE_H_
 #define _HASHTABLE_H_
 
+#include <stdbool.h>
+
 typedef struct entry {
     char *key;
     void *value;
 } entry_t;
 
+// key layout shared by tables that hold the same keys in the same order
+typedef struct hash_shape {
+    // in insertion order, owned by the shape
+    char **keys;
+    size_t *key_lens;
+    size_t *slots;
+    size_t size;
+    // capacity of the tables the slots belong to
+    size_t capacity;
+    size_t refcount;
+} hash_shape_t;
+
 typedef struct hashtable {
     entry_t *entries;
     size_t size;
     size_t capacity;
+    // when set, keys are borrowed from the shape instead of owned
+    hash_shape_t *shape;
+    // set once a key may have been inserted twice, never cleared
+    bool repeats;
+    // set by removals, which can split probe chains until the next rehash
+    bool holes;
 } hashtable_t;
 
 void *safe_malloc(size_t);
@@ -20,9 +40,35 @@ void *safe_realloc(void *, size_t, size_t);
 hashtable_t *hash_init();
 // value should be heap allocated
 void hash_insert(hashtable_t *, const char *, size_t, void *);
-// search key must be null terminated
+// djb2 over the first len bytes of key
+size_t hash_key(const char *, size_t);
+/*
+ * Search key must be null terminated, returns NULL if the key is absent. On
+ * shaped tables the slot of the last hit is remembered per thread, so a
+ * lookup with the same key pointer on a same shaped table skips the probe.
+ */
 void *hash_search(const hashtable_t *, const char *);
+// same as hash_search, but with a hash precomputed by hash_key
+void *hash_search_hashed(const hashtable_t *, const char *, size_t);
 void hash_destroy(hashtable_t *);
+// returns the removed value or NULL if the key is absent
 void *hash_remove(hashtable_t *, const char *);
 
+// empty table with the shape's layout, filled by hash_insert_shaped
+hashtable_t *hash_init_shaped(hash_shape_t *);
+// inserts the shape's key at the given index of its insertion order
+void hash_insert_shaped(hashtable_t *, size_t, void *);
+/*
+ * Hands the table's keys over to a new shape, given in insertion order and
+ * not null terminated. Returns NULL if a key is missing or repeated.
+ */
+hash_shape_t *hash_shape_create(hashtable_t *, const char *const *,
+        const size_t *, size_t);
+void hash_shape_retain(hash_shape_t *);
+void hash_shape_release(hash_shape_t *);
+// gives the table its own copy of the shape's keys, before any mutation
+void hash_unshare(hashtable_t *);
+// copies the slot layout and keys, values are copied with the callback
+hashtable_t *hash_clone(const hashtable_t *, void *(*)(const void *));
+
 #endif // _HASHTABLE_H_
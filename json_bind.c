@@ -0,0 +1,444 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "json_bind.h"
+#include "json_scan.h"
+
+static const char *skip_ws(const char *s) {
+    while (*s == ' ' || *s == '\n' || *s == '\r' || *s == '\t') {
+        s++;
+    }
+
+    return s;
+}
+
+bool json_binding_init(json_binding_t *binding) {
+    if (binding->hashes) {
+        return true;
+    } else if (binding->size > JSON_BIND_MAX_FIELDS) {
+        fprintf(stderr, "json: too many fields in binding\n");
+        return false;
+    }
+
+    for (size_t i = 0; i < binding->size; i++) {
+        const json_field_t *field = (binding->fields + i);
+        bool is_struct = field->type == FIELD_STRUCT
+            || (field->type == FIELD_ARRAY && field->elem_type == FIELD_STRUCT);
+        if ((field->type == FIELD_ARRAY && field->elem_type == FIELD_ARRAY)
+                || (is_struct && !field->binding)) {
+            fprintf(stderr, "json: invalid field in binding\n");
+            return false;
+        }
+    }
+
+    // set before recursing, so that a binding nesting itself stops here
+    binding->key_lens = safe_malloc(binding->size * sizeof(size_t));
+    binding->hashes = safe_malloc(binding->size * sizeof(size_t));
+    for (size_t i = 0; i < binding->size; i++) {
+        const json_field_t *field = (binding->fields + i);
+        binding->key_lens[i] = strlen(field->key);
+        binding->hashes[i] = hash_key(field->key, binding->key_lens[i]);
+    }
+
+    for (size_t i = 0; i < binding->size; i++) {
+        const json_field_t *field = (binding->fields + i);
+        if (field->binding && !json_binding_init(field->binding)) {
+            // or the next call would take it as initialised
+            json_binding_destroy(binding);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void json_binding_destroy(json_binding_t *binding) {
+    free(binding->key_lens);
+    free(binding->hashes);
+    binding->key_lens = NULL;
+    binding->hashes = NULL;
+}
+
+static size_t elem_size(const json_field_t *field) {
+    switch (field->elem_type) {
+        case FIELD_BOOL:
+            return sizeof(bool);
+        case FIELD_INT:
+            return sizeof(long long);
+        case FIELD_DOUBLE:
+            return sizeof(double);
+        case FIELD_STRING:
+            return sizeof(char *);
+        case FIELD_STRUCT:
+            return field->binding->struct_size;
+        default:
+            return 0;
+    }
+}
+
+static char *put_utf8(char *out, unsigned long cp) {
+    if (cp < 0x80) {
+        *out++ = cp;
+    } else if (cp < 0x800) {
+        *out++ = 0xC0 | (cp >> 6);
+        *out++ = 0x80 | (cp & 0x3F);
+    } else if (cp < 0x10000) {
+        *out++ = 0xE0 | (cp >> 12);
+        *out++ = 0x80 | ((cp >> 6) & 0x3F);
+        *out++ = 0x80 | (cp & 0x3F);
+    } else {
+        *out++ = 0xF0 | (cp >> 18);
+        *out++ = 0x80 | ((cp >> 12) & 0x3F);
+        *out++ = 0x80 | ((cp >> 6) & 0x3F);
+        *out++ = 0x80 | (cp & 0x3F);
+    }
+
+    return out;
+}
+
+static bool read_hex(const char *s, unsigned long *cp) {
+    *cp = 0;
+    for (int i = 0; i < 4; i++) {
+        char c = s[i];
+        *cp <<= 4;
+        if (c >= '0' && c <= '9') {
+            *cp |= c - '0';
+        } else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f') {
+            *cp |= (c | 0x20) - 'a' + 10;
+        } else {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// s points at the opening quote, returns NULL on an invalid string
+static const char *bind_string(const char *s, char **dst) {
+    const char *end = json_skip_value(s);
+    if (!end) {
+        return NULL;
+    }
+
+    // unescaping never makes a string longer
+    char *out = safe_malloc((end - s) * sizeof(char));
+    char *str = out;
+    unsigned long cp, low;
+
+    for (s++; s < end - 1; s++) {
+        if (*s != '\\') {
+            *out++ = *s;
+            continue;
+        }
+
+        switch (*++s) {
+            case 'b':
+                *out++ = '\b';
+                break;
+            case 'f':
+                *out++ = '\f';
+                break;
+            case 'n':
+                *out++ = '\n';
+                break;
+            case 'r':
+                *out++ = '\r';
+                break;
+            case 't':
+                *out++ = '\t';
+                break;
+            case 'u':
+                if (!read_hex(s + 1, &cp)) {
+                    goto FAIL;
+                }
+                s += 4;
+                if (cp >= 0xD800 && cp < 0xDC00 && s[1] == '\\'
+                        && s[2] == 'u' && read_hex(s + 3, &low)
+                        && low >= 0xDC00 && low < 0xE000) {
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                    s += 6;
+                }
+                out = put_utf8(out, cp);
+                break;
+            case '"':
+            case '\\':
+            case '/':
+                *out++ = *s;
+                break;
+            default:
+                goto FAIL;
+        }
+    }
+
+    *out = '\0';
+    *dst = str;
+    return end;
+
+FAIL:
+    free(str);
+    return NULL;
+}
+
+static const char *bind_object(const char *, json_binding_t *, char *);
+static void free_value(json_field_type, const json_field_t *, char *);
+
+static const char *bind_value(const char *s, json_field_type type,
+        const json_field_t *field, char *dst) {
+    char *end;
+    const char *num_end;
+    size_t count = 0, capacity = 0, size;
+    char *elems = NULL;
+
+    switch (type) {
+        case FIELD_BOOL:
+            if (!strncmp(s, "true", 4)) {
+                *((bool *) dst) = true;
+                return s + 4;
+            } else if (!strncmp(s, "false", 5)) {
+                *((bool *) dst) = false;
+                return s + 5;
+            }
+            return NULL;
+        case FIELD_INT:
+            // strto* also take a '+', hex, nan and inf, JSON doesn't
+            if (!(num_end = json_scan_number(s))) {
+                return NULL;
+            }
+            errno = 0;
+            *((long long *) dst) = strtoll(s, &end, 10);
+            // a fraction or exponent stops strtoll short of the token end
+            return (end == num_end && errno != ERANGE) ? end : NULL;
+        case FIELD_DOUBLE:
+            if (!(num_end = json_scan_number(s))) {
+                return NULL;
+            }
+            *((double *) dst) = strtod(s, &end);
+            return (end == num_end && !isinf(*((double *) dst))) ? end : NULL;
+        case FIELD_STRING:
+            return (*s == '"') ? bind_string(s, (char **) dst) : NULL;
+        case FIELD_STRUCT:
+            return (*s == '{') ? bind_object(s, field->binding, dst) : NULL;
+        case FIELD_ARRAY:
+            if (*s != '[') {
+                return NULL;
+            }
+
+            size = elem_size(field);
+            // store as we go so that a failure frees what was bound
+            *((char **) dst) = NULL;
+            *((size_t *) (dst - field->offset + field->count_offset)) = 0;
+            s = skip_ws(s + 1);
+            while (*s != ']') {
+                if (count == capacity) {
+                    capacity = capacity ? capacity * 2 : 4;
+                    elems = safe_realloc(elems, capacity, size);
+                }
+                memset((elems + (count * size)), 0, size);
+                *((char **) dst) = elems;
+                *((size_t *) (dst - field->offset + field->count_offset)) =
+                    ++count;
+
+                s = bind_value(s, field->elem_type, field,
+                        (elems + ((count - 1) * size)));
+                if (!s) {
+                    return NULL;
+                }
+                s = skip_ws(s);
+                if (*s == ',') {
+                    s = skip_ws(s + 1);
+                } else if (*s != ']') {
+                    return NULL;
+                }
+            }
+            return s + 1;
+    }
+
+    return NULL;
+}
+
+static const char *bind_object(const char *s, json_binding_t *binding,
+        char *dst) {
+    unsigned long long seen = 0;
+
+    for (s = skip_ws(s + 1); *s != '}';) {
+        if (*s != '"') {
+            return NULL;
+        }
+
+        const char *key = s + 1;
+        if (!(s = json_skip_value(s))) {
+            return NULL;
+        }
+        size_t key_len = s - key - 1;
+        size_t key_hash = hash_key(key, key_len);
+
+        s = skip_ws(s);
+        if (*s != ':') {
+            return NULL;
+        }
+        s = skip_ws(s + 1);
+
+        size_t i = 0;
+        for (; i < binding->size; i++) {
+            if (binding->hashes[i] == key_hash
+                    && binding->key_lens[i] == key_len
+                    && !memcmp(binding->fields[i].key, key, key_len)) {
+                break;
+            }
+        }
+
+        if (i == binding->size) {
+            s = json_skip_value(s);
+        } else if (!strncmp(s, "null", 4)) {
+            // null reads as a missing field
+            s += 4;
+        } else {
+            const json_field_t *field = (binding->fields + i);
+            if ((seen >> i) & 1) {
+                // duplicate key, the last value wins
+                free_value(field->type, field, (dst + field->offset));
+            }
+            s = bind_value(s, field->type, field, (dst + field->offset));
+            seen |= 1ULL << i;
+        }
+
+        if (!s) {
+            return NULL;
+        }
+        s = skip_ws(s);
+        if (*s == ',') {
+            s = skip_ws(s + 1);
+        } else if (*s != '}') {
+            return NULL;
+        }
+    }
+
+    for (size_t i = 0; i < binding->size; i++) {
+        if (binding->fields[i].required && !((seen >> i) & 1)) {
+            fprintf(stderr, "json: missing field %s\n",
+                    binding->fields[i].key);
+            return NULL;
+        }
+    }
+
+    return s + 1;
+}
+
+bool json_bind(const char *json, json_binding_t *binding, void *out) {
+    if (!json_binding_init(binding)) {
+        return false;
+    }
+
+    memset(out, 0, binding->struct_size);
+    const char *s = skip_ws(json);
+    if (*s == '{') {
+        s = bind_object(s, binding, out);
+    } else {
+        s = NULL;
+    }
+
+    if (!s || *skip_ws(s)) {
+        fprintf(stderr, "json: bind failed\n");
+        json_bind_free(binding, out);
+        return false;
+    }
+
+    return true;
+}
+
+static void free_value(json_field_type type, const json_field_t *field,
+        char *value) {
+    char *elems;
+    size_t count, size;
+
+    switch (type) {
+        case FIELD_STRING:
+            free(*((char **) value));
+            *((char **) value) = NULL;
+            break;
+        case FIELD_STRUCT:
+            json_bind_free(field->binding, value);
+            break;
+        case FIELD_ARRAY:
+            elems = *((char **) value);
+            count = *((size_t *) (value - field->offset
+                        + field->count_offset));
+            size = elem_size(field);
+            for (size_t i = 0; i < count; i++) {
+                free_value(field->elem_type, field, (elems + (i * size)));
+            }
+            free(elems);
+            *((char **) value) = NULL;
+            *((size_t *) (value - field->offset + field->count_offset)) = 0;
+            break;
+        default:
+            break;
+    }
+}
+
+void json_bind_free(const json_binding_t *binding, void *obj) {
+    for (size_t i = 0; i < binding->size; i++) {
+        const json_field_t *field = (binding->fields + i);
+        free_value(field->type, field, ((char *) obj + field->offset));
+    }
+}
+
+static bool write_value(json_builder_t *b, json_field_type type,
+        const json_field_t *field, const char *value) {
+    const char *str, *elems;
+    size_t count, size;
+
+    switch (type) {
+        case FIELD_BOOL:
+            return json_builder_value_bool(b, *((bool *) value));
+        case FIELD_INT:
+            return json_builder_value_int(b, *((long long *) value));
+        case FIELD_DOUBLE:
+            return json_builder_value_number(b, *((double *) value));
+        case FIELD_STRING:
+            str = *((char **) value);
+            return str ? json_builder_value_string(b, str, strlen(str))
+                : json_builder_value_null(b);
+        case FIELD_STRUCT:
+            return json_bind_write(b, field->binding, value);
+        case FIELD_ARRAY:
+            elems = *((char **) value);
+            count = *((size_t *) (value - field->offset
+                        + field->count_offset));
+            size = elem_size(field);
+            json_builder_begin_array(b);
+            for (size_t i = 0; i < count; i++) {
+                write_value(b, field->elem_type, field, (elems + (i * size)));
+            }
+            return json_builder_end_array(b);
+    }
+
+    return false;
+}
+
+bool json_bind_write(json_builder_t *b, json_binding_t *binding,
+        const void *obj) {
+    if (!json_binding_init(binding)) {
+        return false;
+    }
+
+    json_builder_begin_object(b);
+    for (size_t i = 0; i < binding->size; i++) {
+        const json_field_t *field = (binding->fields + i);
+        const char *value = ((const char *) obj + field->offset);
+        if (field->type == FIELD_STRING && !field->required
+                && !*((char **) value)) {
+            continue;
+        }
+
+        json_builder_key(b, field->key, binding->key_lens[i]);
+        write_value(b, field->type, field, value);
+    }
+
+    return json_builder_end_object(b);
+}
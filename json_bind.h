@@ -0,0 +1,77 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+#ifndef _JSON_BIND_H_
+#define _JSON_BIND_H_
+
+#include <stddef.h>
+
+#include "json_builder.h"
+
+#define JSON_BIND_MAX_FIELDS 64
+
+typedef enum json_field_type {
+    FIELD_BOOL,     // bool
+    FIELD_INT,      // long long
+    FIELD_DOUBLE,   // double
+    FIELD_STRING,   // char *, heap allocated, NULL for null
+    FIELD_STRUCT,   // nested struct described by a binding
+    FIELD_ARRAY     // heap allocated elements plus a size_t count, arrays
+                    // of arrays are rejected by json_binding_init
+} json_field_type;
+
+struct json_binding;
+
+typedef struct json_field {
+    const char *key;
+    json_field_type type;
+    size_t offset;
+    bool required;
+    // FIELD_ARRAY only
+    json_field_type elem_type;
+    size_t count_offset;
+    // FIELD_STRUCT, or FIELD_ARRAY of FIELD_STRUCT
+    struct json_binding *binding;
+} json_field_t;
+
+typedef struct json_binding {
+    const json_field_t *fields;
+    size_t size;
+    size_t struct_size;
+    // key lengths and hashes, filled in by json_binding_init
+    size_t *key_lens;
+    size_t *hashes;
+} json_binding_t;
+
+#define JSON_FIELD(type, member, field_type, required) \
+    {#member, field_type, offsetof(type, member), required, 0, 0, NULL}
+#define JSON_FIELD_STRUCT(type, member, binding, required) \
+    {#member, FIELD_STRUCT, offsetof(type, member), required, 0, 0, binding}
+#define JSON_FIELD_ARRAY(type, member, count, elem_type, binding, required) \
+    {#member, FIELD_ARRAY, offsetof(type, member), required, elem_type, \
+        offsetof(type, count), binding}
+#define JSON_BINDING(type, fields) \
+    {fields, sizeof(fields) / sizeof(*(fields)), sizeof(type), NULL, NULL}
+
+/*
+ * Precomputes the key hashes of a binding and the bindings it nests. The
+ * bind calls do it on first use, call it up front when a binding is shared
+ * between threads. Fails on a binding with too many fields, an array of
+ * arrays or a struct field without a binding, leaving it uninitialised.
+ */
+bool json_binding_init(json_binding_t *);
+void json_binding_destroy(json_binding_t *);
+
+/*
+ * Parses straight into the struct, no json_entry_t tree is built. The struct
+ * is zeroed first, so missing optional fields read as 0, false or NULL.
+ * Unknown keys are skipped and strings are unescaped. On failure anything
+ * allocated is freed and false is returned.
+ */
+bool json_bind(const char *, json_binding_t *, void *);
+// frees the strings and arrays held by a bound struct, not the struct itself
+void json_bind_free(const json_binding_t *, void *);
+// appends the struct as an object, optional NULL strings are left out and
+// non-finite doubles fail the builder
+bool json_bind_write(json_builder_t *, json_binding_t *, const void *);
+
+#endif // _JSON_BIND_H_
@@ -0,0 +1,288 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "json_builder.h"
+
+#define INITIAL_CAPACITY 256
+
+static const char hex[] = "0123456789abcdef";
+
+json_builder_t *json_builder_create() {
+    json_builder_t *b = safe_malloc(sizeof(json_builder_t));
+    b->capacity = INITIAL_CAPACITY;
+    b->buf = safe_malloc(b->capacity * sizeof(char));
+    json_builder_reset(b);
+
+    return b;
+}
+
+void json_builder_reset(json_builder_t *b) {
+    b->len = 0;
+    b->buf[0] = '\0';
+    b->depth = 0;
+    b->first = true;
+    b->expect_value = false;
+    b->done = false;
+    b->failed = false;
+}
+
+void json_builder_destroy(json_builder_t *b) {
+    free(b->buf);
+    free(b);
+}
+
+// makes room for n more chars and the '\0'
+static void reserve(json_builder_t *b, size_t n) {
+    if (b->len + n + 1 > b->capacity) {
+        while (b->len + n + 1 > b->capacity) {
+            b->capacity *= 2;
+        }
+        b->buf = safe_realloc(b->buf, b->capacity, sizeof(char));
+    }
+}
+
+static void put(json_builder_t *b, const char *data, size_t len) {
+    reserve(b, len);
+    memcpy((b->buf + b->len), data, len);
+    b->len += len;
+    b->buf[b->len] = '\0';
+}
+
+static void put_char(json_builder_t *b, char c) {
+    reserve(b, 1);
+    b->buf[b->len++] = c;
+    b->buf[b->len] = '\0';
+}
+
+static void put_escaped(json_builder_t *b, const char *str, size_t len) {
+    // worst case every byte becomes a \u00XX escape
+    reserve(b, (6 * len) + 2);
+    char *out = (b->buf + b->len);
+
+    *out++ = '"';
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = str[i];
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            *out++ = c;
+            continue;
+        }
+
+        *out++ = '\\';
+        switch (c) {
+            case '"':
+            case '\\':
+                *out++ = c;
+                break;
+            case '\b':
+                *out++ = 'b';
+                break;
+            case '\f':
+                *out++ = 'f';
+                break;
+            case '\n':
+                *out++ = 'n';
+                break;
+            case '\r':
+                *out++ = 'r';
+                break;
+            case '\t':
+                *out++ = 't';
+                break;
+            default:
+                *out++ = 'u';
+                *out++ = '0';
+                *out++ = '0';
+                *out++ = hex[c >> 4];
+                *out++ = hex[c & 0xF];
+                break;
+        }
+    }
+    *out++ = '"';
+
+    b->len = out - b->buf;
+    b->buf[b->len] = '\0';
+}
+
+static bool fail(json_builder_t *b, const char *msg) {
+    if (!b->failed) {
+        fprintf(stderr, "json: builder %s\n", msg);
+        b->failed = true;
+    }
+
+    return false;
+}
+
+static bool before_value(json_builder_t *b) {
+    if (b->failed) {
+        return false;
+    } else if (b->done) {
+        return fail(b, "document already complete");
+    } else if (b->depth && b->is_object[b->depth - 1]) {
+        if (!b->expect_value) {
+            return fail(b, "expected a key");
+        }
+    } else if (b->depth && !b->first) {
+        put_char(b, ',');
+    }
+
+    b->expect_value = false;
+    return true;
+}
+
+static bool after_value(json_builder_t *b) {
+    b->first = false;
+    if (!b->depth) {
+        b->done = true;
+    }
+
+    return true;
+}
+
+static bool begin(json_builder_t *b, bool is_object) {
+    if (!before_value(b)) {
+        return false;
+    } else if (b->depth == JSON_BUILDER_MAX_DEPTH) {
+        return fail(b, "nesting too deep");
+    }
+
+    b->is_object[b->depth++] = is_object;
+    b->first = true;
+    put_char(b, is_object ? '{' : '[');
+
+    return true;
+}
+
+static bool end(json_builder_t *b, bool is_object) {
+    if (b->failed) {
+        return false;
+    } else if (!b->depth || b->is_object[b->depth - 1] != is_object) {
+        return fail(b, "mismatched end");
+    } else if (b->expect_value) {
+        return fail(b, "key without a value");
+    }
+
+    b->depth--;
+    put_char(b, is_object ? '}' : ']');
+
+    return after_value(b);
+}
+
+bool json_builder_begin_object(json_builder_t *b) {
+    return begin(b, true);
+}
+
+bool json_builder_end_object(json_builder_t *b) {
+    return end(b, true);
+}
+
+bool json_builder_begin_array(json_builder_t *b) {
+    return begin(b, false);
+}
+
+bool json_builder_end_array(json_builder_t *b) {
+    return end(b, false);
+}
+
+bool json_builder_key(json_builder_t *b, const char *key, size_t len) {
+    if (b->failed) {
+        return false;
+    } else if (!b->depth || !b->is_object[b->depth - 1] || b->expect_value) {
+        return fail(b, "unexpected key");
+    }
+
+    if (!b->first) {
+        put_char(b, ',');
+    }
+    put_escaped(b, key, len);
+    put_char(b, ':');
+    b->expect_value = true;
+
+    return true;
+}
+
+bool json_builder_value_string(json_builder_t *b, const char *str,
+        size_t len) {
+    if (!before_value(b)) {
+        return false;
+    }
+
+    put_escaped(b, str, len);
+
+    return after_value(b);
+}
+
+bool json_builder_value_number(json_builder_t *b, long double ld) {
+    if (!isfinite(ld)) {
+        return fail(b, "number not finite");
+    } else if (!before_value(b)) {
+        return false;
+    }
+
+    reserve(b, JSON_NUMBER_LENGTH);
+    b->len += json_format_number(ld, (b->buf + b->len));
+
+    return after_value(b);
+}
+
+bool json_builder_value_int(json_builder_t *b, long long n) {
+    if (!before_value(b)) {
+        return false;
+    }
+
+    char digits[24];
+    size_t i = sizeof(digits);
+    unsigned long long u = (n < 0)
+        ? -(unsigned long long) n : (unsigned long long) n;
+
+    do {
+        digits[--i] = '0' + (u % 10);
+        u /= 10;
+    } while (u);
+
+    if (n < 0) {
+        digits[--i] = '-';
+    }
+    put(b, (digits + i), sizeof(digits) - i);
+
+    return after_value(b);
+}
+
+bool json_builder_value_bool(json_builder_t *b, bool value) {
+    if (!before_value(b)) {
+        return false;
+    }
+
+    if (value) {
+        put(b, "true", 4);
+    } else {
+        put(b, "false", 5);
+    }
+
+    return after_value(b);
+}
+
+bool json_builder_value_null(json_builder_t *b) {
+    if (!before_value(b)) {
+        return false;
+    }
+
+    put(b, "null", 4);
+
+    return after_value(b);
+}
+
+const char *json_builder_text(const json_builder_t *b, size_t *n) {
+    if (b->failed || !b->done) {
+        return NULL;
+    }
+
+    if (n) {
+        *n = b->len;
+    }
+
+    return b->buf;
+}
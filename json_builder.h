@@ -0,0 +1,51 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+#ifndef _JSON_BUILDER_H_
+#define _JSON_BUILDER_H_
+
+#include "libjson.h"
+
+#define JSON_BUILDER_MAX_DEPTH 64
+
+typedef struct json_builder {
+    char *buf;
+    size_t len;
+    size_t capacity;
+    bool is_object[JSON_BUILDER_MAX_DEPTH];
+    size_t depth;
+    // nothing written yet in the innermost container
+    bool first;
+    // a key was written, its value must follow
+    bool expect_value;
+    bool done;
+    bool failed;
+} json_builder_t;
+
+// returned value is heap allocated
+json_builder_t *json_builder_create();
+// empties the builder, keeping its buffer for the next document
+void json_builder_reset(json_builder_t *);
+void json_builder_destroy(json_builder_t *);
+
+/*
+ * Each call appends to the text and checks it against the nesting state, a
+ * misplaced call fails the builder and every later call returns false.
+ * Strings are raw and get escaped, lengths are in bytes. NaN and infinities
+ * have no JSON form and fail the builder.
+ */
+bool json_builder_begin_object(json_builder_t *);
+bool json_builder_end_object(json_builder_t *);
+bool json_builder_begin_array(json_builder_t *);
+bool json_builder_end_array(json_builder_t *);
+bool json_builder_key(json_builder_t *, const char *, size_t);
+bool json_builder_value_string(json_builder_t *, const char *, size_t);
+bool json_builder_value_number(json_builder_t *, long double);
+bool json_builder_value_int(json_builder_t *, long long);
+bool json_builder_value_bool(json_builder_t *, bool);
+bool json_builder_value_null(json_builder_t *);
+
+// null terminated text, owned by the builder; NULL if the document is
+// incomplete or the builder failed
+const char *json_builder_text(const json_builder_t *, size_t *);
+
+#endif // _JSON_BUILDER_H_
@@ -0,0 +1,269 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "json_columns.h"
+#include "json_scan.h"
+
+#define INITIAL_ROWS 64
+
+static const char *skip_ws(const char *s) {
+    while (*s == ' ' || *s == '\n' || *s == '\r' || *s == '\t') {
+        s++;
+    }
+
+    return s;
+}
+
+static void grow_rows(json_table_t *table) {
+    size_t capacity = table->capacity ? table->capacity * 2 : INITIAL_ROWS;
+
+    for (size_t i = 0; i < table->size; i++) {
+        json_column_t *col = (table->columns + i);
+        switch (col->type) {
+            case COLUMN_INT64:
+                col->ints = safe_realloc(col->ints, capacity,
+                        sizeof(int64_t));
+                break;
+            case COLUMN_DOUBLE:
+                col->doubles = safe_realloc(col->doubles, capacity,
+                        sizeof(double));
+                break;
+            case COLUMN_BOOL:
+                col->bools = safe_realloc(col->bools, capacity, sizeof(bool));
+                break;
+            case COLUMN_STRING:
+                col->offsets = safe_realloc(col->offsets, capacity + 1,
+                        sizeof(size_t));
+                break;
+        }
+
+        col->validity = safe_realloc(col->validity, (capacity + 7) / 8,
+                sizeof(uint8_t));
+        memset((col->validity + (table->capacity + 7) / 8), 0,
+                ((capacity + 7) / 8) - ((table->capacity + 7) / 8));
+    }
+
+    table->capacity = capacity;
+}
+
+static void append_data(json_column_t *col, const char *data, size_t len) {
+    if (col->data_size + len > col->data_capacity) {
+        while (col->data_size + len > col->data_capacity) {
+            col->data_capacity = col->data_capacity
+                ? col->data_capacity * 2 : 256;
+        }
+        col->data = safe_realloc(col->data, col->data_capacity, sizeof(char));
+    }
+
+    memcpy((col->data + col->data_size), data, len);
+    col->data_size += len;
+}
+
+// empty and invalid, row must be the last one read
+static void clear_cell(json_column_t *col, size_t row) {
+    col->validity[row / 8] &= ~(1 << (row % 8));
+
+    switch (col->type) {
+        case COLUMN_INT64:
+            col->ints[row] = 0;
+            break;
+        case COLUMN_DOUBLE:
+            col->doubles[row] = 0;
+            break;
+        case COLUMN_BOOL:
+            col->bools[row] = false;
+            break;
+        case COLUMN_STRING:
+            col->data_size = col->offsets[row];
+            col->offsets[row + 1] = col->offsets[row];
+            break;
+    }
+}
+
+/*
+ * Returns the end of the value, which is skipped if it doesn't fit the
+ * column. A repeated key replaces whatever the earlier one left in the row.
+ */
+static const char *read_cell(json_column_t *col, size_t row, const char *s) {
+    char *end;
+    bool valid = false;
+    const char *str_end, *num_end;
+
+    clear_cell(col, row);
+    switch (col->type) {
+        case COLUMN_INT64:
+            if ((num_end = json_scan_number(s))) {
+                errno = 0;
+                col->ints[row] = strtoll(s, &end, 10);
+                valid = end == num_end && errno != ERANGE;
+            }
+            break;
+        case COLUMN_DOUBLE:
+            if ((num_end = json_scan_number(s))) {
+                col->doubles[row] = strtod(s, &end);
+                valid = end == num_end && !isinf(col->doubles[row]);
+            }
+            break;
+        case COLUMN_BOOL:
+            if (!strncmp(s, "true", 4) || !strncmp(s, "false", 5)) {
+                col->bools[row] = *s == 't';
+                end = (char *) s + (*s == 't' ? 4 : 5);
+                valid = true;
+            }
+            break;
+        case COLUMN_STRING:
+            if (*s == '"' && (str_end = json_skip_value(s))) {
+                append_data(col, (s + 1), (str_end - s - 2));
+                col->offsets[row + 1] = col->data_size;
+                end = (char *) str_end;
+                valid = true;
+            }
+            break;
+    }
+
+    if (valid) {
+        col->validity[row / 8] |= 1 << (row % 8);
+        return end;
+    }
+
+    clear_cell(col, row);
+    return json_skip_value(s);
+}
+
+static const char *read_row(json_table_t *table, const char *s) {
+    size_t row = table->rows;
+
+    if (row == table->capacity) {
+        grow_rows(table);
+    }
+
+    for (size_t i = 0; i < table->size; i++) {
+        clear_cell((table->columns + i), row);
+    }
+
+    // fields usually come in the same order, try the next column first
+    size_t next = 0;
+    for (s = skip_ws(s + 1); *s != '}';) {
+        if (*s != '"') {
+            return NULL;
+        }
+
+        const char *key = s + 1;
+        if (!(s = json_skip_value(s))) {
+            return NULL;
+        }
+        size_t key_len = s - key - 1;
+
+        s = skip_ws(s);
+        if (*s != ':') {
+            return NULL;
+        }
+        s = skip_ws(s + 1);
+
+        json_column_t *col = NULL;
+        if (next < table->size && table->columns[next].name_len == key_len
+                && !memcmp(table->columns[next].name, key, key_len)) {
+            col = (table->columns + next);
+        } else {
+            size_t key_hash = hash_key(key, key_len);
+            for (size_t i = 0; i < table->size; i++) {
+                if (table->columns[i].hash == key_hash
+                        && table->columns[i].name_len == key_len
+                        && !memcmp(table->columns[i].name, key, key_len)) {
+                    col = (table->columns + i);
+                    break;
+                }
+            }
+        }
+
+        if (col) {
+            next = (col - table->columns) + 1;
+            s = read_cell(col, row, s);
+        } else {
+            s = json_skip_value(s);
+        }
+
+        if (!s) {
+            return NULL;
+        }
+        s = skip_ws(s);
+        if (*s == ',') {
+            s = skip_ws(s + 1);
+        } else if (*s != '}') {
+            return NULL;
+        }
+    }
+
+    table->rows++;
+    return s + 1;
+}
+
+json_table_t *json_columns_extract(const char *json,
+        const char *const *names, const json_column_type *types, size_t n) {
+    json_table_t *table = safe_malloc(sizeof(json_table_t));
+    table->columns = safe_malloc(n * sizeof(json_column_t));
+    table->size = n;
+    table->rows = 0;
+    table->capacity = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        json_column_t *col = (table->columns + i);
+        memset(col, 0, sizeof(json_column_t));
+        col->name_len = strlen(names[i]);
+        col->name = strndup(names[i], col->name_len);
+        col->hash = hash_key(col->name, col->name_len);
+        col->type = types[i];
+    }
+    grow_rows(table);
+    for (size_t i = 0; i < n; i++) {
+        if (table->columns[i].type == COLUMN_STRING) {
+            table->columns[i].offsets[0] = 0;
+        }
+    }
+
+    const char *s = skip_ws(json);
+    if (*s != '[') {
+        goto FAIL;
+    }
+
+    for (s = skip_ws(s + 1); *s != ']';) {
+        if (*s != '{' || !(s = read_row(table, s))) {
+            goto FAIL;
+        }
+
+        s = skip_ws(s);
+        if (*s == ',') {
+            s = skip_ws(s + 1);
+        } else if (*s != ']') {
+            goto FAIL;
+        }
+    }
+
+    return table;
+
+FAIL:
+    fprintf(stderr, "json: invalid record array\n");
+    json_table_destroy(table);
+    return NULL;
+}
+
+void json_table_destroy(json_table_t *table) {
+    for (size_t i = 0; i < table->size; i++) {
+        json_column_t *col = (table->columns + i);
+        free(col->name);
+        free(col->ints);
+        free(col->doubles);
+        free(col->bools);
+        free(col->offsets);
+        free(col->data);
+        free(col->validity);
+    }
+
+    free(table->columns);
+    free(table);
+}
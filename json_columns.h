@@ -0,0 +1,59 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+#ifndef _JSON_COLUMNS_H_
+#define _JSON_COLUMNS_H_
+
+#include <stdint.h>
+
+#include "libjson.h"
+
+typedef enum json_column_type {
+    COLUMN_INT64,
+    COLUMN_DOUBLE,
+    COLUMN_BOOL,
+    COLUMN_STRING
+} json_column_type;
+
+typedef struct json_column {
+    char *name;
+    size_t name_len;
+    size_t hash;
+    json_column_type type;
+    // set according to type, one value per row
+    int64_t *ints;
+    double *doubles;
+    bool *bools;
+    // COLUMN_STRING, row i is data[offsets[i]] up to data[offsets[i + 1]]
+    size_t *offsets;
+    char *data;
+    size_t data_size;
+    size_t data_capacity;
+    // bit i is set when row i has a value of the column's type
+    uint8_t *validity;
+} json_column_t;
+
+typedef struct json_table {
+    json_column_t *columns;
+    size_t size;
+    size_t rows;
+    size_t capacity;
+} json_table_t;
+
+/*
+ * Reads a top level array of flat objects straight from the text into one
+ * typed column per requested field, no json_entry_t is built. Missing
+ * fields, nulls and values of another type leave the row invalid. Other
+ * fields are skipped. When a field repeats, its last occurrence decides the
+ * row. Strings are stored as they appear in the input, still escaped. The
+ * returned value is heap allocated, NULL if the input isn't an array of
+ * objects.
+ */
+json_table_t *json_columns_extract(const char *, const char *const *,
+        const json_column_type *, size_t);
+void json_table_destroy(json_table_t *);
+
+static inline bool json_column_valid(const json_column_t *column, size_t row) {
+    return (column->validity[row / 8] >> (row % 8)) & 1;
+}
+
+#endif // _JSON_COLUMNS_H_
@@ -0,0 +1,466 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "json_doc.h"
+
+typedef struct block_size {
+    size_t nodes;
+    size_t keys;
+    size_t bytes;
+} block_size_t;
+
+// bump allocator over one block: nodes first, then keys, then strings
+typedef struct bump {
+    json_frozen_t *nodes;
+    const char **keys;
+    char *bytes;
+} bump_t;
+
+typedef struct member {
+    const char *key;
+    const json_entry_t *value;
+} member_t;
+
+static void measure_entry(const json_entry_t *entry, block_size_t *m) {
+    json_obj_t *obj;
+    json_array_t *arr;
+
+    m->nodes++;
+    switch (entry->type) {
+        case OBJECT:
+            obj = entry->item;
+            for (size_t i = 0; i < obj->capacity; i++) {
+                entry_t *e = (obj->entries + i);
+                if (e->key) {
+                    m->keys++;
+                    m->bytes += strlen(e->key) + 1;
+                    measure_entry(e->value, m);
+                }
+            }
+            break;
+        case ARRAY:
+            arr = entry->item;
+            for (size_t i = 0; i < arr->size; i++) {
+                measure_entry((arr->entries + i), m);
+            }
+            break;
+        case STRING:
+            m->bytes += strlen(entry->item) + 1;
+            break;
+        default:
+            break;
+    }
+}
+
+static void measure_frozen(const json_frozen_t *node, block_size_t *m) {
+    m->nodes++;
+    switch (node->type) {
+        case OBJECT:
+            for (size_t i = 0; i < node->size; i++) {
+                m->keys++;
+                m->bytes += strlen(node->keys[i]) + 1;
+            }
+            // fall through
+        case ARRAY:
+            for (size_t i = 0; i < node->size; i++) {
+                measure_frozen((node->value.children + i), m);
+            }
+            break;
+        case STRING:
+            m->bytes += node->size + 1;
+            break;
+        default:
+            break;
+    }
+}
+
+static json_doc_t *doc_init(const block_size_t *m, bump_t *b) {
+    size_t nodes = m->nodes * sizeof(json_frozen_t);
+    size_t keys = m->keys * sizeof(char *);
+    char *block = safe_malloc(nodes + keys + m->bytes);
+
+    b->nodes = (json_frozen_t *) block;
+    b->keys = (const char **) (block + nodes);
+    b->bytes = (block + nodes + keys);
+
+    json_doc_t *doc = safe_malloc(sizeof(json_doc_t));
+    doc->root = NULL;
+    doc->block = block;
+    doc->base = NULL;
+    doc->refcount = 1;
+
+    return doc;
+}
+
+static json_frozen_t *alloc_nodes(bump_t *b, size_t n) {
+    json_frozen_t *nodes = b->nodes;
+    b->nodes += n;
+
+    return nodes;
+}
+
+static const char **alloc_keys(bump_t *b, size_t n) {
+    const char **keys = b->keys;
+    b->keys += n;
+
+    return keys;
+}
+
+static const char *copy_string(bump_t *b, const char *str, size_t len) {
+    char *copy = b->bytes;
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+    b->bytes += len + 1;
+
+    return copy;
+}
+
+static int compare_members(const void *a, const void *b) {
+    return strcmp(((const member_t *) a)->key, ((const member_t *) b)->key);
+}
+
+static void fill_entry(bump_t *b, json_frozen_t *node,
+        const json_entry_t *entry) {
+    json_obj_t *obj;
+    json_array_t *arr;
+    json_frozen_t *children;
+    const char **keys;
+    member_t *members;
+    size_t n = 0;
+
+    node->type = entry->type;
+    node->size = 0;
+    node->keys = NULL;
+
+    switch (entry->type) {
+        case OBJECT:
+            obj = entry->item;
+            members = safe_malloc(obj->size * sizeof(member_t));
+            for (size_t i = 0; i < obj->capacity; i++) {
+                entry_t *e = (obj->entries + i);
+                if (e->key) {
+                    members[n].key = e->key;
+                    members[n].value = e->value;
+                    n++;
+                }
+            }
+            qsort(members, n, sizeof(member_t), compare_members);
+
+            children = alloc_nodes(b, n);
+            keys = alloc_keys(b, n);
+            for (size_t i = 0; i < n; i++) {
+                keys[i] = copy_string(b, members[i].key,
+                        strlen(members[i].key));
+                fill_entry(b, (children + i), members[i].value);
+            }
+            free(members);
+
+            node->size = n;
+            node->value.children = children;
+            node->keys = keys;
+            break;
+        case ARRAY:
+            arr = entry->item;
+            children = alloc_nodes(b, arr->size);
+            for (size_t i = 0; i < arr->size; i++) {
+                fill_entry(b, (children + i), (arr->entries + i));
+            }
+            node->size = arr->size;
+            node->value.children = children;
+            break;
+        case STRING:
+            node->size = strlen(entry->item);
+            node->value.string = copy_string(b, entry->item, node->size);
+            break;
+        case NUMBER:
+            node->value.number = *((long double *) entry->item);
+            break;
+        case BOOL:
+            node->value.boolean = *((bool *) entry->item);
+            break;
+        default:
+            break;
+    }
+}
+
+static void fill_frozen(bump_t *b, json_frozen_t *node,
+        const json_frozen_t *src) {
+    json_frozen_t *children;
+    const char **keys;
+
+    *node = *src;
+    switch (src->type) {
+        case OBJECT:
+        case ARRAY:
+            children = alloc_nodes(b, src->size);
+            for (size_t i = 0; i < src->size; i++) {
+                fill_frozen(b, (children + i), (src->value.children + i));
+            }
+            node->value.children = children;
+
+            if (src->type == OBJECT) {
+                keys = alloc_keys(b, src->size);
+                for (size_t i = 0; i < src->size; i++) {
+                    keys[i] = copy_string(b, src->keys[i],
+                            strlen(src->keys[i]));
+                }
+                node->keys = keys;
+            }
+            break;
+        case STRING:
+            node->value.string = copy_string(b, src->value.string, src->size);
+            break;
+        default:
+            break;
+    }
+}
+
+json_doc_t *json_freeze(const json_entry_t *entry) {
+    block_size_t m = {0, 0, 0};
+    bump_t b;
+
+    measure_entry(entry, &m);
+    json_doc_t *doc = doc_init(&m, &b);
+    json_frozen_t *root = alloc_nodes(&b, 1);
+    fill_entry(&b, root, entry);
+    doc->root = root;
+
+    return doc;
+}
+
+json_doc_t *json_doc_compact(const json_doc_t *src) {
+    block_size_t m = {0, 0, 0};
+    bump_t b;
+
+    measure_frozen(src->root, &m);
+    json_doc_t *doc = doc_init(&m, &b);
+    json_frozen_t *root = alloc_nodes(&b, 1);
+    fill_frozen(&b, root, src->root);
+    doc->root = root;
+
+    return doc;
+}
+
+json_entry_t *json_thaw(const json_frozen_t *node) {
+    json_entry_t *entry = NULL, *child;
+
+    switch (node->type) {
+        case OBJECT:
+            entry = json_create_obj();
+            for (size_t i = 0; i < node->size; i++) {
+                json_insert_obj_entry(entry->item, node->keys[i],
+                        strlen(node->keys[i]),
+                        json_thaw(node->value.children + i));
+            }
+            break;
+        case ARRAY:
+            entry = json_create_array();
+            for (size_t i = 0; i < node->size; i++) {
+                child = json_thaw(node->value.children + i);
+                json_insert_array_entry(entry->item, child);
+                free(child);
+            }
+            break;
+        case STRING:
+            entry = json_create_string(node->value.string, node->size);
+            break;
+        case NUMBER:
+            entry = json_create_number(node->value.number);
+            break;
+        case BOOL:
+            entry = json_create_bool(node->value.boolean);
+            break;
+        default:
+            entry = json_create_null();
+            break;
+    }
+
+    return entry;
+}
+
+void json_doc_retain(json_doc_t *doc) {
+    __atomic_add_fetch(&doc->refcount, 1, __ATOMIC_RELAXED);
+}
+
+void json_doc_release(json_doc_t *doc) {
+    // freeing a version drops its hold on the one it was derived from
+    while (doc && !__atomic_sub_fetch(&doc->refcount, 1, __ATOMIC_ACQ_REL)) {
+        json_doc_t *base = doc->base;
+        free(doc->block);
+        free(doc);
+        doc = base;
+    }
+}
+
+// index of the first key not less than key, sets found on an exact match
+static size_t lower_bound(const json_frozen_t *node, const char *key,
+        bool *found) {
+    size_t lo = 0, hi = node->size;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (strcmp(node->keys[mid], key) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    *found = lo < node->size && !strcmp(node->keys[lo], key);
+    return lo;
+}
+
+const json_frozen_t *json_frozen_get(const json_frozen_t *node,
+        const char *key) {
+    bool found;
+
+    if (node->type != OBJECT) {
+        return NULL;
+    }
+
+    size_t i = lower_bound(node, key, &found);
+
+    return found ? (node->value.children + i) : NULL;
+}
+
+const json_frozen_t *json_frozen_at(const json_frozen_t *node,
+        size_t index) {
+    if (node->type != ARRAY || index >= node->size) {
+        return NULL;
+    }
+
+    return (node->value.children + index);
+}
+
+const json_frozen_t *json_frozen_eval(const json_frozen_t *node,
+        const json_path_t *path) {
+    for (size_t i = 0; node && i < path->size; i++) {
+        const json_path_step_t *step = (path->steps + i);
+        if (node->type == OBJECT) {
+            node = step->key ? json_frozen_get(node, step->key) : NULL;
+        } else {
+            node = json_frozen_at(node, step->index);
+        }
+    }
+
+    return node;
+}
+
+// value is NULL for a removal
+static json_doc_t *edit(json_doc_t *doc, const json_path_t *path,
+        const json_entry_t *value) {
+    if (!path->size) {
+        return value ? json_freeze(value) : NULL;
+    }
+
+    const json_frozen_t **chain = safe_malloc(path->size
+            * sizeof(json_frozen_t *));
+    size_t *pos = safe_malloc(path->size * sizeof(size_t));
+    const json_frozen_t *cur = doc->root;
+    block_size_t m = {1, 0, 0};
+    json_doc_t *res = NULL;
+    bool insert = false;
+    bool found;
+
+    // resolve the path and size the copies of the containers along it
+    for (size_t i = 0; i < path->size; i++) {
+        const json_path_step_t *step = (path->steps + i);
+        bool last = i + 1 == path->size;
+
+        chain[i] = cur;
+        if (cur->type == OBJECT && step->key) {
+            pos[i] = lower_bound(cur, step->key, &found);
+            if (!found && (!last || !value)) {
+                goto END;
+            }
+            insert = !found;
+            m.nodes += cur->size + insert;
+            m.keys += cur->size + insert;
+            m.bytes += insert ? step->key_len + 1 : 0;
+        } else if (cur->type == ARRAY) {
+            pos[i] = (step->index == JSON_PATH_END_INDEX)
+                ? cur->size : step->index;
+            insert = last && value && pos[i] == cur->size;
+            if (pos[i] >= cur->size && !insert) {
+                goto END;
+            }
+            m.nodes += cur->size + insert;
+        } else {
+            goto END;
+        }
+
+        if (!last) {
+            cur = (cur->value.children + pos[i]);
+        }
+    }
+
+    if (value) {
+        measure_entry(value, &m);
+    }
+
+    bump_t b;
+    res = doc_init(&m, &b);
+    json_frozen_t *node = alloc_nodes(&b, 1);
+    *node = *doc->root;
+    res->root = node;
+
+    for (size_t i = 0; i < path->size; i++) {
+        const json_frozen_t *old = chain[i];
+        bool last = i + 1 == path->size;
+        bool grow = last && insert;
+        bool shrink = last && !value;
+        size_t p = pos[i];
+        size_t n = old->size + grow - shrink;
+        // elements after p move by one when inserting or removing
+        size_t tail = old->size - p - shrink;
+
+        json_frozen_t *children = alloc_nodes(&b, n);
+        memcpy(children, old->value.children, p * sizeof(json_frozen_t));
+        memcpy((children + p + grow), (old->value.children + p + shrink),
+                tail * sizeof(json_frozen_t));
+
+        if (old->type == OBJECT) {
+            const char **keys = alloc_keys(&b, n);
+            memcpy(keys, old->keys, p * sizeof(char *));
+            memcpy((keys + p + grow), (old->keys + p + shrink),
+                    tail * sizeof(char *));
+            if (grow) {
+                keys[p] = copy_string(&b, path->steps[i].key,
+                        path->steps[i].key_len);
+            }
+            node->keys = keys;
+        }
+
+        node->size = n;
+        node->value.children = children;
+
+        if (!last) {
+            node = (children + p);
+        } else if (value) {
+            fill_entry(&b, (children + p), value);
+        }
+    }
+
+    json_doc_retain(doc);
+    res->base = doc;
+
+END:
+    free(chain);
+    free(pos);
+    if (!res) {
+        fprintf(stderr, "json: path doesn't resolve\n");
+    }
+    return res;
+}
+
+json_doc_t *json_doc_set(json_doc_t *doc, const json_path_t *path,
+        const json_entry_t *value) {
+    return edit(doc, path, value);
+}
+
+json_doc_t *json_doc_remove(json_doc_t *doc, const json_path_t *path) {
+    return edit(doc, path, NULL);
+}
@@ -0,0 +1,65 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+#ifndef _JSON_DOC_H_
+#define _JSON_DOC_H_
+
+#include "json_path.h"
+
+// immutable node, never modified once its document is published
+typedef struct json_frozen {
+    entry_type type;
+    // members, elements or string length
+    size_t size;
+    union {
+        bool boolean;
+        long double number;
+        const char *string;
+        // members or elements, laid out next to each other
+        const struct json_frozen *children;
+    } value;
+    // OBJECT only, member keys sorted by strcmp, parallel to children
+    const char *const *keys;
+} json_frozen_t;
+
+// one immutable version, readers share it through the reference count
+typedef struct json_doc {
+    const json_frozen_t *root;
+    // holds the nodes, keys and strings created for this version
+    void *block;
+    // older version that unchanged subtrees still point into
+    struct json_doc *base;
+    size_t refcount;
+} json_doc_t;
+
+/*
+ * Copies a tree into one contiguous block, the returned document starts with
+ * a reference count of 1 and is heap allocated.
+ */
+json_doc_t *json_freeze(const json_entry_t *);
+// copies a version into a single block that doesn't depend on older ones
+json_doc_t *json_doc_compact(const json_doc_t *);
+// mutable copy, the returned value is heap allocated
+json_entry_t *json_thaw(const json_frozen_t *);
+
+// atomic, safe to call from any thread holding a reference
+void json_doc_retain(json_doc_t *);
+void json_doc_release(json_doc_t *);
+
+/*
+ * Copy-on-write edits: the returned version, with a reference count of 1,
+ * copies only the nodes along the path and shares everything else with the
+ * given one, which stays valid and unchanged. set adds or replaces the value
+ * and accepts the "-" index to append. Both return NULL if the path doesn't
+ * resolve.
+ */
+json_doc_t *json_doc_set(json_doc_t *, const json_path_t *,
+        const json_entry_t *);
+json_doc_t *json_doc_remove(json_doc_t *, const json_path_t *);
+
+// lookups never lock or write, they return NULL when nothing matches
+const json_frozen_t *json_frozen_get(const json_frozen_t *, const char *);
+const json_frozen_t *json_frozen_at(const json_frozen_t *, size_t);
+const json_frozen_t *json_frozen_eval(const json_frozen_t *,
+        const json_path_t *);
+
+#endif // _JSON_DOC_H_
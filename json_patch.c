@@ -0,0 +1,361 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "json_patch.h"
+#include "json_path.h"
+
+typedef struct pointer_buf {
+    char *buf;
+    size_t len;
+    size_t capacity;
+} pointer_buf_t;
+
+// frees the contents of dst and moves src, a heap allocated entry, into it
+static void move_into(json_entry_t *dst, json_entry_t *src) {
+    json_nullify_entry(dst);
+    *dst = *src;
+    free(src);
+}
+
+void json_merge_patch(json_entry_t *target, const json_entry_t *patch) {
+    if (patch->type != OBJECT) {
+        move_into(target, json_clone(patch));
+        return;
+    } else if (target->type != OBJECT) {
+        move_into(target, json_create_obj());
+    }
+
+    json_obj_t *obj = target->item;
+    json_obj_t *patch_obj = patch->item;
+    for (size_t i = 0; i < patch_obj->capacity; i++) {
+        entry_t *e = (patch_obj->entries + i);
+        if (!e->key) {
+            continue;
+        }
+
+        json_entry_t *value = e->value;
+        json_entry_t *cur = json_get_obj_entry(obj, e->key);
+        if (value->type == NIL) {
+            if (cur) {
+                json_remove_obj_entry(obj, e->key);
+            }
+        } else if (cur) {
+            json_merge_patch(cur, value);
+        } else {
+            if (value->type == OBJECT) {
+                // nested nulls must be dropped, not copied
+                cur = json_create_obj();
+                json_merge_patch(cur, value);
+            } else {
+                cur = json_clone(value);
+            }
+            json_insert_obj_entry(obj, e->key, strlen(e->key), cur);
+        }
+    }
+}
+
+static json_entry_t *get_member(const json_obj_t *obj, const char *key,
+        entry_type type) {
+    json_entry_t *entry = json_get_obj_entry(obj, key);
+
+    return (entry && entry->type == type) ? entry : NULL;
+}
+
+static json_entry_t *get_parent(const json_entry_t *doc,
+        const json_path_t *path) {
+    if (!path->size) {
+        return NULL;
+    }
+
+    return json_path_eval_steps(path->steps, path->size - 1, doc);
+}
+
+// takes ownership of value, a heap allocated entry, only when it succeeds
+static bool add_value(json_entry_t *doc, const json_path_t *path,
+        json_entry_t *value) {
+    if (!path->size) {
+        move_into(doc, value);
+        return true;
+    }
+
+    json_entry_t *parent = get_parent(doc, path);
+    json_path_step_t *step = (path->steps + path->size - 1);
+    size_t index = step->index;
+    json_array_t *arr;
+    json_entry_t *cur;
+
+    switch (parent ? parent->type : UNKNOWN) {
+        case OBJECT:
+            cur = hash_search_hashed(parent->item, step->key, step->hash);
+            if (cur) {
+                move_into(cur, value);
+            } else {
+                json_insert_obj_entry(parent->item, step->key, step->key_len,
+                        value);
+            }
+            return true;
+        case ARRAY:
+            arr = parent->item;
+            if (index == JSON_PATH_END_INDEX) {
+                index = arr->size;
+            } else if (index > arr->size) {
+                break;
+            }
+            json_insert_array_entry(arr, value);
+            free(value);
+            if (index + 1 != arr->size) {
+                json_entry_t tmp = arr->entries[arr->size - 1];
+                memmove((arr->entries + index + 1), (arr->entries + index),
+                        (arr->size - index - 1) * sizeof(json_entry_t));
+                arr->entries[index] = tmp;
+            }
+            return true;
+        default:
+            break;
+    }
+
+    return false;
+}
+
+// returns the removed value, heap allocated, or NULL if it doesn't exist
+static json_entry_t *detach_value(json_entry_t *doc, const json_path_t *path) {
+    json_entry_t *parent = get_parent(doc, path);
+    json_path_step_t *step = (path->steps + path->size - 1);
+    json_array_t *arr;
+    json_entry_t *value = NULL;
+
+    switch (parent ? parent->type : UNKNOWN) {
+        case OBJECT:
+            if (step->key) {
+                value = hash_remove(parent->item, step->key);
+            }
+            break;
+        case ARRAY:
+            arr = parent->item;
+            if (step->index < arr->size) {
+                value = safe_malloc(sizeof(json_entry_t));
+                *value = arr->entries[step->index];
+                // the contents now belong to value, leave a null behind
+                arr->entries[step->index].type = NIL;
+                arr->entries[step->index].item = NULL;
+                json_remove_array_entry(arr, step->index);
+            }
+            break;
+        default:
+            break;
+    }
+
+    return value;
+}
+
+static bool is_proper_prefix(const json_path_t *prefix,
+        const json_path_t *path) {
+    if (prefix->size >= path->size) {
+        return false;
+    }
+
+    for (size_t i = 0; i < prefix->size; i++) {
+        if (prefix->steps[i].key_len != path->steps[i].key_len
+                || memcmp(prefix->steps[i].key, path->steps[i].key,
+                    path->steps[i].key_len)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool apply_op(json_entry_t *doc, const json_obj_t *op) {
+    json_entry_t *op_name = get_member(op, "op", STRING);
+    json_entry_t *pointer = get_member(op, "path", STRING);
+    json_entry_t *from_pointer = get_member(op, "from", STRING);
+    json_entry_t *value = json_get_obj_entry(op, "value");
+    json_path_t *path = NULL, *from = NULL;
+    json_entry_t *target;
+    bool res = false;
+
+    if (!op_name || !pointer
+            || !(path = json_path_compile_pointer(pointer->item))) {
+        goto END;
+    }
+
+    const char *name = op_name->item;
+    if (!strcmp(name, "add") && value) {
+        target = json_clone(value);
+        if (!(res = add_value(doc, path, target))) {
+            json_destroy(target);
+        }
+    } else if (!strcmp(name, "remove") && path->size) {
+        if ((target = detach_value(doc, path))) {
+            json_destroy(target);
+            res = true;
+        }
+    } else if (!strcmp(name, "replace") && value) {
+        if ((target = json_path_eval(path, doc))) {
+            move_into(target, json_clone(value));
+            res = true;
+        }
+    } else if (!strcmp(name, "test") && value) {
+        target = json_path_eval(path, doc);
+        res = target && json_equal(target, value);
+    } else if (from_pointer
+            && (from = json_path_compile_pointer(from_pointer->item))) {
+        if (!strcmp(name, "move")) {
+            if (!from->size) {
+                res = !path->size;
+            } else if (!is_proper_prefix(from, path)
+                    && (target = detach_value(doc, from))) {
+                // the source's parent is untouched, so it goes straight back
+                if (!(res = add_value(doc, path, target))) {
+                    add_value(doc, from, target);
+                }
+            }
+        } else if (!strcmp(name, "copy")) {
+            if ((target = json_path_eval(from, doc))) {
+                target = json_clone(target);
+                if (!(res = add_value(doc, path, target))) {
+                    json_destroy(target);
+                }
+            }
+        }
+    }
+
+END:
+    if (!res) {
+        fprintf(stderr, "json: patch operation failed\n");
+    }
+    json_path_destroy(path);
+    json_path_destroy(from);
+    return res;
+}
+
+bool json_patch_apply(json_entry_t *doc, const json_entry_t *patch) {
+    json_array_t *ops = json_get_array(patch);
+    if (!ops) {
+        return false;
+    }
+
+    for (size_t i = 0; i < ops->size; i++) {
+        json_obj_t *op = json_get_obj(ops->entries + i);
+        if (!op || !apply_op(doc, op)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void pointer_append(pointer_buf_t *ptr, const char *token) {
+    size_t len = strlen(token);
+    if (ptr->len + (2 * len) + 2 > ptr->capacity) {
+        ptr->capacity = ptr->len + (2 * len) + 2;
+        ptr->buf = safe_realloc(ptr->buf, ptr->capacity, sizeof(char));
+    }
+
+    ptr->buf[ptr->len++] = '/';
+    for (; *token; token++) {
+        if (*token == '~' || *token == '/') {
+            ptr->buf[ptr->len++] = '~';
+            ptr->buf[ptr->len++] = (*token == '~') ? '0' : '1';
+        } else {
+            ptr->buf[ptr->len++] = *token;
+        }
+    }
+    ptr->buf[ptr->len] = '\0';
+}
+
+static void push_op(json_array_t *ops, const char *name,
+        const pointer_buf_t *ptr, const json_entry_t *value) {
+    json_entry_t *op = json_create_obj();
+    json_insert_obj_entry(op->item, "op", 2,
+            json_create_string(name, strlen(name)));
+    json_insert_obj_entry(op->item, "path", 4,
+            json_create_string(ptr->buf, ptr->len));
+    if (value) {
+        json_insert_obj_entry(op->item, "value", 5, json_clone(value));
+    }
+
+    json_insert_array_entry(ops, op);
+    free(op);
+}
+
+static void diff(json_array_t *ops, pointer_buf_t *ptr,
+        const json_entry_t *from, const json_entry_t *to) {
+    size_t len = ptr->len;
+
+    if (from->type == OBJECT && to->type == OBJECT) {
+        json_obj_t *from_obj = from->item;
+        json_obj_t *to_obj = to->item;
+
+        for (size_t i = 0; i < from_obj->capacity; i++) {
+            entry_t *e = (from_obj->entries + i);
+            if (e->key && !json_get_obj_entry(to_obj, e->key)) {
+                pointer_append(ptr, e->key);
+                push_op(ops, "remove", ptr, NULL);
+                ptr->buf[ptr->len = len] = '\0';
+            }
+        }
+
+        for (size_t i = 0; i < to_obj->capacity; i++) {
+            entry_t *e = (to_obj->entries + i);
+            if (!e->key) {
+                continue;
+            }
+
+            json_entry_t *cur = json_get_obj_entry(from_obj, e->key);
+            pointer_append(ptr, e->key);
+            if (cur) {
+                diff(ops, ptr, cur, e->value);
+            } else {
+                push_op(ops, "add", ptr, e->value);
+            }
+            ptr->buf[ptr->len = len] = '\0';
+        }
+    } else if (from->type == ARRAY && to->type == ARRAY) {
+        json_array_t *from_arr = from->item;
+        json_array_t *to_arr = to->item;
+        size_t common = (from_arr->size < to_arr->size)
+            ? from_arr->size : to_arr->size;
+        char index[24];
+
+        for (size_t i = 0; i < common; i++) {
+            sprintf(index, "%zu", i);
+            pointer_append(ptr, index);
+            diff(ops, ptr, (from_arr->entries + i), (to_arr->entries + i));
+            ptr->buf[ptr->len = len] = '\0';
+        }
+
+        // remove from the back so that earlier indices stay valid
+        for (size_t i = from_arr->size; i > common; i--) {
+            sprintf(index, "%zu", i - 1);
+            pointer_append(ptr, index);
+            push_op(ops, "remove", ptr, NULL);
+            ptr->buf[ptr->len = len] = '\0';
+        }
+
+        for (size_t i = common; i < to_arr->size; i++) {
+            pointer_append(ptr, "-");
+            push_op(ops, "add", ptr, (to_arr->entries + i));
+            ptr->buf[ptr->len = len] = '\0';
+        }
+    } else if (!json_equal(from, to)) {
+        push_op(ops, "replace", ptr, to);
+    }
+}
+
+json_entry_t *json_diff(const json_entry_t *from, const json_entry_t *to) {
+    json_entry_t *patch = json_create_array();
+    pointer_buf_t ptr;
+    ptr.capacity = 64;
+    ptr.len = 0;
+    ptr.buf = safe_malloc(ptr.capacity * sizeof(char));
+    ptr.buf[0] = '\0';
+
+    diff(patch->item, &ptr, from, to);
+
+    free(ptr.buf);
+    return patch;
+}
@@ -0,0 +1,20 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+#ifndef _JSON_PATCH_H_
+#define _JSON_PATCH_H_
+
+#include "libjson.h"
+
+// RFC 7386 merge patch, applied to the target in place
+void json_merge_patch(json_entry_t *, const json_entry_t *);
+/*
+ * RFC 6902 patch, applied to the document in place. Only the touched
+ * subtrees are modified and moved values aren't copied. Returns false at the
+ * first operation that fails, the operations before it stay applied and
+ * the failing one leaves the document as it found it.
+ */
+bool json_patch_apply(json_entry_t *, const json_entry_t *);
+// RFC 6902 patch turning the first tree into the second, heap allocated
+json_entry_t *json_diff(const json_entry_t *, const json_entry_t *);
+
+#endif // _JSON_PATCH_H_
@@ -0,0 +1,202 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "json_path.h"
+
+static json_path_t *path_init() {
+    json_path_t *path = safe_malloc(sizeof(json_path_t));
+    path->steps = NULL;
+    path->size = 0;
+
+    return path;
+}
+
+static json_path_step_t *path_add_step(json_path_t *path) {
+    path->steps = safe_realloc(path->steps, path->size + 1,
+            sizeof(json_path_step_t));
+    json_path_step_t *step = (path->steps + path->size);
+    step->key = NULL;
+    step->key_len = 0;
+    step->hash = 0;
+    step->index = JSON_PATH_NO_INDEX;
+    path->size++;
+
+    return step;
+}
+
+static size_t parse_index(const char *token, size_t len) {
+    if (!len || (token[0] == '0' && len > 1)) {
+        return JSON_PATH_NO_INDEX;
+    }
+
+    size_t index = 0;
+    for (size_t i = 0; i < len; i++) {
+        size_t digit = token[i] - '0';
+        // too large for any array, and never one of the sentinels
+        if (!isdigit(token[i])
+                || index > (JSON_PATH_END_INDEX - 1 - digit) / 10) {
+            return JSON_PATH_NO_INDEX;
+        }
+        index = (index * 10) + digit;
+    }
+
+    return index;
+}
+
+static void set_key(json_path_step_t *step, char *key, size_t len) {
+    key[len] = '\0';
+    step->key = key;
+    step->key_len = len;
+    step->hash = hash_key(key, len);
+}
+
+json_path_t *json_path_compile_pointer(const char *pointer) {
+    if (*pointer && *pointer != '/') {
+        fprintf(stderr, "json: pointer must start with '/'\n");
+        return NULL;
+    }
+
+    json_path_t *path = path_init();
+    while (*pointer) {
+        pointer++;
+        size_t len = strcspn(pointer, "/");
+        char *key = safe_malloc((len + 1) * sizeof(char));
+        size_t key_len = 0;
+
+        for (size_t i = 0; i < len; i++) {
+            if (pointer[i] != '~') {
+                key[key_len++] = pointer[i];
+            } else if (pointer[i + 1] == '0' || pointer[i + 1] == '1') {
+                key[key_len++] = (pointer[++i] == '0') ? '~' : '/';
+            } else {
+                fprintf(stderr, "json: invalid pointer escape\n");
+                free(key);
+                json_path_destroy(path);
+                return NULL;
+            }
+        }
+
+        json_path_step_t *step = path_add_step(path);
+        set_key(step, key, key_len);
+        if (key_len == 1 && *key == '-') {
+            step->index = JSON_PATH_END_INDEX;
+        } else {
+            step->index = parse_index(key, key_len);
+        }
+        pointer += len;
+    }
+
+    return path;
+}
+
+json_path_t *json_path_compile(const char *expr) {
+    if (*expr == '$') {
+        expr++;
+    }
+
+    json_path_t *path = path_init();
+    while (*expr) {
+        json_path_step_t *step = path_add_step(path);
+        size_t len;
+
+        if (*expr == '.') {
+            expr++;
+            len = strcspn(expr, ".[");
+            if (!len) {
+                goto FAIL;
+            }
+            set_key(step, strndup(expr, len), len);
+            expr += len;
+        } else if (*expr == '[' && (expr[1] == '\'' || expr[1] == '"')) {
+            char quote = expr[1];
+            expr += 2;
+            const char *end = strchr(expr, quote);
+            if (!end || end[1] != ']') {
+                goto FAIL;
+            }
+            len = end - expr;
+            set_key(step, strndup(expr, len), len);
+            expr = end + 2;
+        } else if (*expr == '[') {
+            expr++;
+            len = strcspn(expr, "]");
+            step->index = parse_index(expr, len);
+            if (step->index == JSON_PATH_NO_INDEX || expr[len] != ']') {
+                goto FAIL;
+            }
+            expr += len + 1;
+        } else {
+            goto FAIL;
+        }
+    }
+
+    return path;
+
+FAIL:
+    fprintf(stderr, "json: invalid path\n");
+    json_path_destroy(path);
+    return NULL;
+}
+
+void json_path_destroy(json_path_t *path) {
+    if (!path) {
+        return;
+    }
+
+    for (size_t i = 0; i < path->size; i++) {
+        free(path->steps[i].key);
+    }
+
+    free(path->steps);
+    free(path);
+}
+
+json_entry_t *json_path_eval_steps(const json_path_step_t *steps, size_t n,
+        const json_entry_t *entry) {
+    for (size_t i = 0; entry && i < n; i++) {
+        const json_path_step_t *step = (steps + i);
+        json_array_t *arr;
+
+        switch (entry->type) {
+            case OBJECT:
+                if (!step->key) {
+                    return NULL;
+                }
+                entry = hash_search_hashed(entry->item, step->key, step->hash);
+                break;
+            case ARRAY:
+                arr = entry->item;
+                if (step->index >= arr->size) {
+                    return NULL;
+                }
+                entry = (arr->entries + step->index);
+                break;
+            default:
+                return NULL;
+        }
+    }
+
+    return (json_entry_t *) entry;
+}
+
+json_entry_t *json_path_eval(const json_path_t *path,
+        const json_entry_t *entry) {
+    return json_path_eval_steps(path->steps, path->size, entry);
+}
+
+json_entry_t *json_pointer_get(const json_entry_t *entry,
+        const char *pointer) {
+    json_path_t *path = json_path_compile_pointer(pointer);
+    if (!path) {
+        return NULL;
+    }
+
+    json_entry_t *res = json_path_eval(path, entry);
+    json_path_destroy(path);
+
+    return res;
+}
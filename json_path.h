@@ -0,0 +1,40 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+#ifndef _JSON_PATH_H_
+#define _JSON_PATH_H_
+
+#include "libjson.h"
+
+// step index of a token that can't address an array element
+#define JSON_PATH_NO_INDEX ((size_t) -1)
+// step index of the RFC 6901 "-" token, one past the last element
+#define JSON_PATH_END_INDEX ((size_t) -2)
+
+typedef struct json_path_step {
+    // null terminated, NULL if the step can only address an array element
+    char *key;
+    size_t key_len;
+    // hash_key of key, precomputed at compile time
+    size_t hash;
+    size_t index;
+} json_path_step_t;
+
+typedef struct json_path {
+    json_path_step_t *steps;
+    size_t size;
+} json_path_t;
+
+// RFC 6901 pointer, e.g. "/a/0/b~1c"; the returned value is heap allocated
+json_path_t *json_path_compile_pointer(const char *);
+// JSONPath subset: "$", ".key", "['key']", "[\"key\"]" and "[index]"
+json_path_t *json_path_compile(const char *);
+void json_path_destroy(json_path_t *);
+
+// returns NULL if the path doesn't resolve
+json_entry_t *json_path_eval(const json_path_t *, const json_entry_t *);
+json_entry_t *json_path_eval_steps(const json_path_step_t *, size_t,
+        const json_entry_t *);
+// compiles, evaluates and destroys the pointer in one go
+json_entry_t *json_pointer_get(const json_entry_t *, const char *);
+
+#endif // _JSON_PATH_H_
@@ -0,0 +1,276 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "json_scan.h"
+
+typedef unsigned long long path_mask_t;
+
+typedef struct scan {
+    const json_path_t *const *paths;
+    json_view_t *views;
+    size_t remaining;
+} scan_t;
+
+static const char *skip_ws(const char *s) {
+    while (*s == ' ' || *s == '\n' || *s == '\r' || *s == '\t') {
+        s++;
+    }
+
+    return s;
+}
+
+static const char *skip_string(const char *s) {
+    for (s++;;) {
+        s += strcspn(s, "\"\\");
+        if (*s == '"') {
+            return s + 1;
+        } else if (!*s || !s[1]) {
+            return NULL;
+        }
+        s += 2;
+    }
+}
+
+const char *json_skip_value(const char *s) {
+    s = skip_ws(s);
+
+    switch (*s) {
+        case '\0':
+            return NULL;
+        case '"':
+            return skip_string(s);
+        case '{':
+        case '[':;
+            size_t depth = 0;
+            do {
+                s += strcspn(s, "{}[]\"");
+                switch (*s) {
+                    case '\0':
+                        return NULL;
+                    case '"':
+                        if (!(s = skip_string(s))) {
+                            return NULL;
+                        }
+                        continue;
+                    case '{':
+                    case '[':
+                        depth++;
+                        break;
+                    default:
+                        depth--;
+                        break;
+                }
+                s++;
+            } while (depth);
+            return s;
+        case '}':
+        case ']':
+        case ',':
+        case ':':
+            return NULL;
+    }
+
+    s += strcspn(s, ",]} \n\r\t");
+
+    return s;
+}
+
+static const char *skip_digits(const char *s) {
+    if (*s < '0' || *s > '9') {
+        return NULL;
+    }
+
+    while (*s >= '0' && *s <= '9') {
+        s++;
+    }
+
+    return s;
+}
+
+const char *json_scan_number(const char *s) {
+    if (*s == '-') {
+        s++;
+    }
+
+    // no leading zeros
+    if (*s == '0') {
+        s++;
+    } else if (!(s = skip_digits(s))) {
+        return NULL;
+    }
+
+    if (*s == '.' && !(s = skip_digits(s + 1))) {
+        return NULL;
+    }
+
+    if (*s == 'e' || *s == 'E') {
+        s++;
+        if (*s == '+' || *s == '-') {
+            s++;
+        }
+        s = skip_digits(s);
+    }
+
+    return s;
+}
+
+static const char *scan_value(scan_t *, const char *, size_t, path_mask_t);
+
+static const char *scan_object(scan_t *sc, const char *s, size_t depth,
+        path_mask_t mask) {
+    for (s++;;) {
+        s = skip_ws(s);
+        if (*s == '}') {
+            return s + 1;
+        } else if (*s != '"') {
+            return NULL;
+        }
+
+        const char *key = s + 1;
+        if (!(s = skip_string(s))) {
+            return NULL;
+        }
+        size_t key_len = s - key - 1;
+
+        path_mask_t sub = 0;
+        for (size_t i = 0; i < JSON_SCAN_MAX_PATHS && (mask >> i); i++) {
+            const json_path_step_t *step = (sc->paths[i]->steps + depth);
+            if ((mask >> i) & 1 && !sc->views[i].start && step->key
+                    && step->key_len == key_len
+                    && !memcmp(step->key, key, key_len)) {
+                sub |= 1ULL << i;
+            }
+        }
+
+        s = skip_ws(s);
+        if (*s != ':') {
+            return NULL;
+        }
+        s++;
+
+        s = sub ? scan_value(sc, s, depth + 1, sub) : json_skip_value(s);
+        if (!s || !sc->remaining) {
+            return s;
+        }
+
+        s = skip_ws(s);
+        if (*s == '}') {
+            return s + 1;
+        } else if (*s != ',') {
+            return NULL;
+        }
+        s++;
+    }
+}
+
+static const char *scan_array(scan_t *sc, const char *s, size_t depth,
+        path_mask_t mask) {
+    s = skip_ws(s + 1);
+    if (*s == ']') {
+        return s + 1;
+    }
+
+    for (size_t index = 0;; index++) {
+        path_mask_t sub = 0;
+        for (size_t i = 0; i < JSON_SCAN_MAX_PATHS && (mask >> i); i++) {
+            if ((mask >> i) & 1
+                    && sc->paths[i]->steps[depth].index == index) {
+                sub |= 1ULL << i;
+            }
+        }
+
+        s = sub ? scan_value(sc, s, depth + 1, sub) : json_skip_value(s);
+        if (!s || !sc->remaining) {
+            return s;
+        }
+
+        s = skip_ws(s);
+        if (*s == ']') {
+            return s + 1;
+        } else if (*s != ',') {
+            return NULL;
+        }
+        s++;
+    }
+}
+
+static const char *scan_value(scan_t *sc, const char *s, size_t depth,
+        path_mask_t mask) {
+    path_mask_t here = 0;
+    path_mask_t deeper = 0;
+
+    s = skip_ws(s);
+    for (size_t i = 0; i < JSON_SCAN_MAX_PATHS && (mask >> i); i++) {
+        if ((mask >> i) & 1) {
+            if (sc->paths[i]->size == depth) {
+                here |= 1ULL << i;
+            } else {
+                deeper |= 1ULL << i;
+            }
+        }
+    }
+
+    const char *end;
+    if (deeper && *s == '{') {
+        end = scan_object(sc, s, depth, deeper);
+    } else if (deeper && *s == '[') {
+        end = scan_array(sc, s, depth, deeper);
+    } else {
+        end = json_skip_value(s);
+    }
+
+    if (!end) {
+        return NULL;
+    }
+
+    for (size_t i = 0; i < JSON_SCAN_MAX_PATHS && (here >> i); i++) {
+        // with repeated keys the first match wins
+        if ((here >> i) & 1 && !sc->views[i].start) {
+            sc->views[i].start = s;
+            sc->views[i].len = end - s;
+            sc->remaining--;
+        }
+    }
+
+    return end;
+}
+
+size_t json_extract(const char *json, const json_path_t *const *paths,
+        size_t n, json_view_t *views) {
+    if (n > JSON_SCAN_MAX_PATHS) {
+        fprintf(stderr, "json: too many paths\n");
+        return 0;
+    }
+
+    scan_t sc = {paths, views, n};
+    path_mask_t mask = 0;
+    for (size_t i = 0; i < n; i++) {
+        views[i].start = NULL;
+        views[i].len = 0;
+        mask |= 1ULL << i;
+    }
+
+    if (n) {
+        scan_value(&sc, json, 0, mask);
+    }
+
+    return n - sc.remaining;
+}
+
+json_entry_t *json_view_parse(const json_view_t *view) {
+    if (!view->start) {
+        return NULL;
+    }
+
+    char *json = safe_malloc((view->len + 1) * sizeof(char));
+    memcpy(json, view->start, view->len);
+    json[view->len] = '\0';
+
+    json_entry_t *entry = json_parse(json);
+    free(json);
+
+    return entry;
+}
@@ -0,0 +1,36 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+#ifndef _JSON_SCAN_H_
+#define _JSON_SCAN_H_
+
+#include "json_path.h"
+
+#define JSON_SCAN_MAX_PATHS 64
+
+// slice of the scanned buffer holding one complete value
+typedef struct json_view {
+    const char *start;
+    size_t len;
+} json_view_t;
+
+// skips leading whitespace and one value without validating it, returns a
+// pointer just past the value or NULL if the input ends inside of it
+const char *json_skip_value(const char *);
+// matches one number against the JSON grammar, -?int[.frac][(e|E)[+-]exp],
+// returns a pointer just past it or NULL if there isn't one
+const char *json_scan_number(const char *);
+
+/*
+ * Scans a null terminated buffer for up to JSON_SCAN_MAX_PATHS paths and
+ * fills one view per path, start is NULL for paths that weren't found.
+ * Values off the requested paths are skipped, not parsed, and the scan stops
+ * as soon as every path has matched. When repeated keys give a path more
+ * than one match, the first one in the buffer wins. Keys are compared with
+ * their raw, still escaped, text. Returns the number of paths found.
+ */
+size_t json_extract(const char *, const json_path_t *const *, size_t,
+        json_view_t *);
+// returned value is heap allocated
+json_entry_t *json_view_parse(const json_view_t *);
+
+#endif // _JSON_SCAN_H_
@@ -0,0 +1,302 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "json_schema.h"
+
+typedef struct schema_type_name {
+    const char *name;
+    entry_type type;
+} schema_type_name_t;
+
+static const schema_type_name_t type_names[] = {
+    {"null", NIL},
+    {"boolean", BOOL},
+    {"string", STRING},
+    {"number", NUMBER},
+    {"integer", NUMBER},
+    {"array", ARRAY},
+    {"object", OBJECT}
+};
+
+static json_entry_t *get_member(const json_obj_t *obj, const char *key,
+        entry_type type) {
+    json_entry_t *entry = json_get_obj_entry(obj, key);
+
+    return (entry && entry->type == type) ? entry : NULL;
+}
+
+static size_t count_nodes(const json_entry_t *schema) {
+    if (schema->type != OBJECT) {
+        return 1;
+    }
+
+    size_t n = 1;
+    json_entry_t *props = get_member(schema->item, "properties", OBJECT);
+    // whatever compile_node takes a node for, whether or not it compiles
+    json_entry_t *items = json_get_obj_entry(schema->item, "items");
+
+    if (props) {
+        json_obj_t *obj = props->item;
+        for (size_t i = 0; i < obj->capacity; i++) {
+            if (obj->entries[i].key) {
+                n += count_nodes(obj->entries[i].value);
+            }
+        }
+    }
+
+    if (items) {
+        n += count_nodes(items);
+    }
+
+    return n;
+}
+
+static bool add_type(json_schema_node_t *node, const json_entry_t *name) {
+    if (name->type != STRING) {
+        return false;
+    }
+
+    for (size_t i = 0; i < sizeof(type_names) / sizeof(*type_names); i++) {
+        if (!strcmp(type_names[i].name, name->item)) {
+            // "number" lifts the integer restriction of "integer"
+            if (type_names[i].type == NUMBER) {
+                bool is_integer = !strcmp(name->item, "integer");
+                if (!(node->types & (1 << NUMBER))) {
+                    node->integer = is_integer;
+                } else if (!is_integer) {
+                    node->integer = false;
+                }
+            }
+            node->types |= 1 << type_names[i].type;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool get_size(const json_obj_t *obj, const char *key, size_t *res) {
+    json_entry_t *entry = json_get_obj_entry(obj, key);
+    if (!entry) {
+        return true;
+    } else if (entry->type != NUMBER) {
+        return false;
+    }
+
+    long double ld = *((long double *) entry->item);
+    if (ld < 0 || ld != (size_t) ld) {
+        return false;
+    }
+
+    *res = ld;
+    return true;
+}
+
+static bool get_bound(const json_obj_t *obj, const char *key, bool *has,
+        long double *res) {
+    json_entry_t *entry = json_get_obj_entry(obj, key);
+    if (!entry) {
+        return true;
+    } else if (entry->type != NUMBER) {
+        return false;
+    }
+
+    *has = true;
+    *res = *((long double *) entry->item);
+    return true;
+}
+
+static bool compile_node(json_schema_t *schema, const json_entry_t *entry,
+        json_schema_node_t *node) {
+    memset(node, 0, sizeof(json_schema_node_t));
+    node->max_length = SIZE_MAX;
+    node->max_items = SIZE_MAX;
+    node->additional = true;
+
+    // true and {} accept anything, false accepts nothing
+    if (entry->type == BOOL) {
+        if (!*((bool *) entry->item)) {
+            node->types = 1 << UNKNOWN;
+        }
+        return true;
+    } else if (entry->type != OBJECT) {
+        return false;
+    }
+
+    json_obj_t *obj = entry->item;
+    json_entry_t *type = json_get_obj_entry(obj, "type");
+    if (type && type->type == ARRAY) {
+        json_array_t *arr = type->item;
+        for (size_t i = 0; i < arr->size; i++) {
+            if (!add_type(node, (arr->entries + i))) {
+                return false;
+            }
+        }
+    } else if (type && !add_type(node, type)) {
+        return false;
+    }
+
+    if (!get_bound(obj, "minimum", &node->has_minimum, &node->minimum)
+            || !get_bound(obj, "maximum", &node->has_maximum,
+                &node->maximum)
+            || !get_size(obj, "minLength", &node->min_length)
+            || !get_size(obj, "maxLength", &node->max_length)
+            || !get_size(obj, "minItems", &node->min_items)
+            || !get_size(obj, "maxItems", &node->max_items)) {
+        return false;
+    }
+
+    json_entry_t *additional = json_get_obj_entry(obj, "additionalProperties");
+    if (additional) {
+        if (additional->type != BOOL) {
+            return false;
+        }
+        node->additional = *((bool *) additional->item);
+    }
+
+    json_entry_t *props = get_member(obj, "properties", OBJECT);
+    if (props) {
+        json_obj_t *props_obj = props->item;
+        node->props = safe_malloc(props_obj->size * sizeof(json_schema_prop_t));
+        for (size_t i = 0; i < props_obj->capacity; i++) {
+            entry_t *e = (props_obj->entries + i);
+            if (!e->key) {
+                continue;
+            }
+
+            json_schema_prop_t *prop = (node->props + node->props_size++);
+            prop->key_len = strlen(e->key);
+            prop->key = strndup(e->key, prop->key_len);
+            prop->hash = hash_key(prop->key, prop->key_len);
+            prop->required_bit = 0;
+
+            json_schema_node_t *child = (schema->nodes + schema->size++);
+            prop->node = child;
+            if (!compile_node(schema, e->value, child)) {
+                return false;
+            }
+        }
+    }
+
+    json_entry_t *required = get_member(obj, "required", ARRAY);
+    if (required) {
+        json_array_t *arr = required->item;
+        size_t bit = 0;
+        for (size_t i = 0; i < arr->size; i++) {
+            json_entry_t *name = (arr->entries + i);
+            if (name->type != STRING || bit == JSON_SCHEMA_MAX_REQUIRED) {
+                return false;
+            }
+
+            json_schema_prop_t *prop = (json_schema_prop_t *)
+                json_schema_find_prop(node, name->item, strlen(name->item));
+            if (!prop) {
+                // required but otherwise unconstrained
+                node->props = safe_realloc(node->props, node->props_size + 1,
+                        sizeof(json_schema_prop_t));
+                prop = (node->props + node->props_size++);
+                prop->key_len = strlen(name->item);
+                prop->key = strndup(name->item, prop->key_len);
+                prop->hash = hash_key(prop->key, prop->key_len);
+                prop->node = NULL;
+                prop->required_bit = 0;
+            }
+
+            if (!prop->required_bit) {
+                prop->required_bit = 1ULL << bit++;
+                node->required |= prop->required_bit;
+            }
+        }
+    }
+
+    json_entry_t *items = json_get_obj_entry(obj, "items");
+    if (items) {
+        if (items->type != OBJECT && items->type != BOOL) {
+            return false;
+        }
+
+        json_schema_node_t *child = (schema->nodes + schema->size++);
+        node->items = child;
+        if (!compile_node(schema, items, child)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+json_schema_t *json_schema_compile(const json_entry_t *entry) {
+    json_schema_t *schema = safe_malloc(sizeof(json_schema_t));
+    // nodes never move once compiled, so children are plain pointers
+    schema->nodes = safe_malloc(count_nodes(entry)
+            * sizeof(json_schema_node_t));
+    schema->size = 1;
+
+    if (!compile_node(schema, entry, schema->nodes)) {
+        fprintf(stderr, "json: invalid schema\n");
+        json_schema_destroy(schema);
+        return NULL;
+    }
+
+    return schema;
+}
+
+void json_schema_destroy(json_schema_t *schema) {
+    for (size_t i = 0; i < schema->size; i++) {
+        json_schema_node_t *node = (schema->nodes + i);
+        for (size_t j = 0; j < node->props_size; j++) {
+            free(node->props[j].key);
+        }
+        free(node->props);
+    }
+
+    free(schema->nodes);
+    free(schema);
+}
+
+bool json_schema_check_type(const json_schema_node_t *node, entry_type type) {
+    return !node->types || (node->types & (1 << type));
+}
+
+bool json_schema_check_number(const json_schema_node_t *node,
+        long double ld) {
+    return !(node->integer && ld != truncl(ld))
+        && !(node->has_minimum && ld < node->minimum)
+        && !(node->has_maximum && ld > node->maximum);
+}
+
+bool json_schema_check_string(const json_schema_node_t *node,
+        const char *str, size_t len) {
+    size_t chars = 0;
+
+    for (size_t i = 0; i < len; chars++) {
+        if (str[i] == '\\') {
+            i += (str[i + 1] == 'u') ? 6 : 2;
+        } else {
+            // skip utf-8 continuation bytes
+            for (i++; i < len && (str[i] & 0xC0) == 0x80; i++);
+        }
+    }
+
+    return chars >= node->min_length && chars <= node->max_length;
+}
+
+const json_schema_prop_t *json_schema_find_prop(
+        const json_schema_node_t *node, const char *key, size_t len) {
+    size_t key_hash = hash_key(key, len);
+
+    for (size_t i = 0; i < node->props_size; i++) {
+        const json_schema_prop_t *prop = (node->props + i);
+        if (prop->hash == key_hash && prop->key_len == len
+                && !memcmp(prop->key, key, len)) {
+            return prop;
+        }
+    }
+
+    return NULL;
+}
@@ -0,0 +1,76 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+#ifndef _JSON_SCHEMA_H_
+#define _JSON_SCHEMA_H_
+
+#include "libjson.h"
+
+#define JSON_SCHEMA_MAX_REQUIRED 64
+
+struct json_schema_node;
+
+typedef struct json_schema_prop {
+    char *key;
+    size_t key_len;
+    size_t hash;
+    // bit in the node's required mask, 0 if the property is optional
+    unsigned long long required_bit;
+    // NULL accepts any value
+    const struct json_schema_node *node;
+} json_schema_prop_t;
+
+typedef struct json_schema_node {
+    // bitmask of 1 << entry_type, 0 accepts any type
+    unsigned types;
+    // numbers must be integral
+    bool integer;
+    bool has_minimum;
+    bool has_maximum;
+    long double minimum;
+    long double maximum;
+    size_t min_length;
+    size_t max_length;
+    size_t min_items;
+    size_t max_items;
+    json_schema_prop_t *props;
+    size_t props_size;
+    unsigned long long required;
+    bool additional;
+    // NULL accepts any item
+    const struct json_schema_node *items;
+} json_schema_node_t;
+
+// nodes are laid out in one array, the root comes first
+typedef struct json_schema {
+    json_schema_node_t *nodes;
+    size_t size;
+} json_schema_t;
+
+/*
+ * Supports type (including "integer" and type arrays), properties, required,
+ * additionalProperties as a boolean, items as a single schema, minimum,
+ * maximum, minLength, maxLength, minItems and maxItems. Other keywords are
+ * ignored. The returned value is heap allocated.
+ */
+json_schema_t *json_schema_compile(const json_entry_t *);
+void json_schema_destroy(json_schema_t *);
+
+/*
+ * Parses and validates in one pass, the schema is checked as each token is
+ * consumed, so an invalid document is rejected at the first offending value
+ * without parsing the rest of it. Returns NULL if the document is invalid
+ * JSON or doesn't match the schema.
+ */
+json_entry_t *json_parse_schema(const char *, const json_schema_t *);
+
+// checks used by the parser as it consumes tokens
+bool json_schema_check_type(const json_schema_node_t *, entry_type);
+bool json_schema_check_number(const json_schema_node_t *, long double);
+// takes the raw, still escaped, string contents
+bool json_schema_check_string(const json_schema_node_t *, const char *,
+        size_t);
+// returns NULL if the node doesn't declare the property
+const json_schema_prop_t *json_schema_find_prop(const json_schema_node_t *,
+        const char *, size_t);
+
+#endif // _JSON_SCHEMA_H_
@@ -0,0 +1,298 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "json_writer.h"
+
+// strings at least this long go straight to the sink instead of the buffer
+#define DIRECT_WRITE_SIZE (JSON_WRITER_CHUNK / 4)
+
+static json_writer_t *writer_init(writer_sink sink, size_t indent) {
+    json_writer_t *w = safe_malloc(sizeof(json_writer_t));
+    w->sink = sink;
+    w->file = NULL;
+    w->fd = -1;
+    w->cb = NULL;
+    w->ctx = NULL;
+    w->indent = indent;
+    w->failed = false;
+    w->len = 0;
+    w->iov_count = 0;
+    w->seg_start = 0;
+    w->has_refs = false;
+
+    return w;
+}
+
+json_writer_t *json_writer_file(FILE *file, size_t indent) {
+    json_writer_t *w = writer_init(FILE_SINK, indent);
+    w->file = file;
+
+    return w;
+}
+
+json_writer_t *json_writer_fd(int fd, size_t indent) {
+    json_writer_t *w = writer_init(FD_SINK, indent);
+    w->fd = fd;
+
+    return w;
+}
+
+json_writer_t *json_writer_callback(json_write_cb cb, void *ctx,
+        size_t indent) {
+    json_writer_t *w = writer_init(CALLBACK_SINK, indent);
+    w->cb = cb;
+    w->ctx = ctx;
+
+    return w;
+}
+
+static void sink_write(json_writer_t *w, const char *data, size_t len) {
+    while (len && !w->failed) {
+        ssize_t ret;
+        switch (w->sink) {
+            case FILE_SINK:
+                ret = fwrite(data, sizeof(char), len, w->file);
+                if (ret != (ssize_t) len) {
+                    ret = -1;
+                }
+                break;
+            case FD_SINK:
+                ret = write(w->fd, data, len);
+                if (ret == -1 && errno == EINTR) {
+                    continue;
+                }
+                break;
+            default:
+                ret = w->cb(w->ctx, data, len);
+                break;
+        }
+
+        if (ret < 0) {
+            w->failed = true;
+        } else {
+            data += ret;
+            len -= ret;
+        }
+    }
+}
+
+// moves the buffered bytes not yet covered by an iovec into the batch
+static void close_segment(json_writer_t *w) {
+    if (w->len > w->seg_start) {
+        w->iov[w->iov_count].iov_base = (w->buf + w->seg_start);
+        w->iov[w->iov_count].iov_len = w->len - w->seg_start;
+        w->iov_count++;
+        w->seg_start = w->len;
+    }
+}
+
+static void flush_iov(json_writer_t *w) {
+    struct iovec *iov = w->iov;
+    size_t count = w->iov_count;
+
+    while (count && !w->failed) {
+        ssize_t ret = writev(w->fd, iov, count);
+        if (ret == -1) {
+            if (errno != EINTR) {
+                w->failed = true;
+            }
+            continue;
+        }
+
+        while (count && (size_t) ret >= iov->iov_len) {
+            ret -= iov->iov_len;
+            iov++;
+            count--;
+        }
+
+        if (count) {
+            iov->iov_base = ((char *) iov->iov_base + ret);
+            iov->iov_len -= ret;
+        }
+    }
+}
+
+bool json_writer_flush(json_writer_t *w) {
+    if (w->sink == FD_SINK) {
+        close_segment(w);
+        flush_iov(w);
+    } else {
+        sink_write(w, w->buf, w->len);
+    }
+
+    if (w->sink == FILE_SINK && !w->failed && fflush(w->file)) {
+        w->failed = true;
+    }
+
+    w->len = 0;
+    w->seg_start = 0;
+    w->iov_count = 0;
+    w->has_refs = false;
+
+    return !w->failed;
+}
+
+static void put(json_writer_t *w, const char *data, size_t len) {
+    while (len) {
+        size_t n = JSON_WRITER_CHUNK - w->len;
+        if (n > len) {
+            n = len;
+        }
+
+        memcpy((w->buf + w->len), data, n);
+        w->len += n;
+        data += n;
+        len -= n;
+
+        if (w->len == JSON_WRITER_CHUNK) {
+            json_writer_flush(w);
+        }
+    }
+}
+
+// writes data without copying it, data must live until the next flush
+static void put_direct(json_writer_t *w, const char *data, size_t len) {
+    if (w->sink != FD_SINK) {
+        json_writer_flush(w);
+        sink_write(w, data, len);
+        return;
+    }
+
+    close_segment(w);
+    w->iov[w->iov_count].iov_base = (void *) data;
+    w->iov[w->iov_count].iov_len = len;
+    w->iov_count++;
+    w->has_refs = true;
+
+    // keep a slot free for the segment closed by the flush
+    if (w->iov_count >= JSON_WRITER_IOVS - 1) {
+        json_writer_flush(w);
+    }
+}
+
+static void put_char(json_writer_t *w, char c) {
+    w->buf[w->len++] = c;
+    if (w->len == JSON_WRITER_CHUNK) {
+        json_writer_flush(w);
+    }
+}
+
+static void put_newline(json_writer_t *w, size_t depth) {
+    if (!w->indent) {
+        return;
+    }
+
+    put_char(w, '\n');
+    for (size_t i = 0; i < depth * w->indent; i++) {
+        put_char(w, ' ');
+    }
+}
+
+static void put_string(json_writer_t *w, const char *str) {
+    size_t len = strlen(str);
+
+    put_char(w, '"');
+    if (len >= DIRECT_WRITE_SIZE) {
+        put_direct(w, str, len);
+    } else {
+        put(w, str, len);
+    }
+    put_char(w, '"');
+}
+
+static void write_entry(json_writer_t *w, const json_entry_t *entry,
+        size_t depth) {
+    char num[JSON_NUMBER_LENGTH];
+    json_obj_t *obj;
+    json_array_t *arr;
+    bool first = true;
+
+    if (w->failed) {
+        return;
+    }
+
+    switch (entry->type) {
+        case OBJECT:
+            obj = entry->item;
+            put_char(w, '{');
+            for (size_t i = 0; i < obj->capacity && !w->failed; i++) {
+                entry_t *e = (obj->entries + i);
+                if (!e->key) {
+                    continue;
+                }
+                if (!first) {
+                    put_char(w, ',');
+                }
+                first = false;
+                put_newline(w, depth + 1);
+                put_string(w, e->key);
+                put_char(w, ':');
+                if (w->indent) {
+                    put_char(w, ' ');
+                }
+                write_entry(w, e->value, depth + 1);
+            }
+            if (!first) {
+                put_newline(w, depth);
+            }
+            put_char(w, '}');
+            break;
+        case ARRAY:
+            arr = entry->item;
+            put_char(w, '[');
+            for (size_t i = 0; i < arr->size && !w->failed; i++) {
+                if (i) {
+                    put_char(w, ',');
+                }
+                put_newline(w, depth + 1);
+                write_entry(w, (arr->entries + i), depth + 1);
+            }
+            if (arr->size) {
+                put_newline(w, depth);
+            }
+            put_char(w, ']');
+            break;
+        case STRING:
+            put_string(w, entry->item);
+            break;
+        case NUMBER:
+            put(w, num, json_format_number(*((long double *) entry->item),
+                        num));
+            break;
+        case BOOL:
+            if (*((bool *) entry->item)) {
+                put(w, "true", 4);
+            } else {
+                put(w, "false", 5);
+            }
+            break;
+        case NIL:
+            put(w, "null", 4);
+            break;
+        default:
+            break;
+    }
+}
+
+bool json_write(json_writer_t *w, const json_entry_t *entry) {
+    write_entry(w, entry, 0);
+
+    // pending iovecs may point into the tree, which can go away after this
+    if (w->has_refs) {
+        json_writer_flush(w);
+    }
+
+    return !w->failed;
+}
+
+bool json_writer_destroy(json_writer_t *w) {
+    bool res = json_writer_flush(w);
+    free(w);
+
+    return res;
+}
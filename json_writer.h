@@ -0,0 +1,57 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+#ifndef _JSON_WRITER_H_
+#define _JSON_WRITER_H_
+
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include "libjson.h"
+
+#define JSON_WRITER_CHUNK 4096
+#define JSON_WRITER_IOVS 16
+
+// returns the number of bytes consumed, or -1 on error
+typedef ssize_t (*json_write_cb)(void *, const char *, size_t);
+
+typedef enum writer_sink {
+    FILE_SINK,
+    FD_SINK,
+    CALLBACK_SINK
+} writer_sink;
+
+typedef struct json_writer {
+    writer_sink sink;
+    FILE *file;
+    int fd;
+    json_write_cb cb;
+    void *ctx;
+    // spaces per level, 0 writes minified output
+    size_t indent;
+    bool failed;
+    char buf[JSON_WRITER_CHUNK];
+    size_t len;
+    // fd sink only, pending writev batch of buffer segments and long strings
+    struct iovec iov[JSON_WRITER_IOVS];
+    size_t iov_count;
+    size_t seg_start;
+    bool has_refs;
+} json_writer_t;
+
+// returned values are heap allocated
+json_writer_t *json_writer_file(FILE *, size_t);
+json_writer_t *json_writer_fd(int, size_t);
+json_writer_t *json_writer_callback(json_write_cb, void *, size_t);
+
+/*
+ * Streams the tree through the writer's buffer, output reaches the sink in
+ * JSON_WRITER_CHUNK sized pieces. Strings are written as stored, like
+ * json_stringify does. Returns false once any write has failed.
+ */
+bool json_write(json_writer_t *, const json_entry_t *);
+bool json_writer_flush(json_writer_t *);
+// flushes and frees the writer, returns false if any write failed
+bool json_writer_destroy(json_writer_t *);
+
+#endif // _JSON_WRITER_H_
@@ -9,17 +9,41 @@
 #include <sys/types.h>
 
 #include "libjson.h"
+#include "json_schema.h"
 
 #define SHRINK_FACTOR 0.30f
 
 #define print_error(msg) fprintf(stderr, "%s: %c (index %d)\n",\
         msg, *s, s - orig);
 
-static const size_t DEFAULT_NUMBER_LENGTH =
-    ((size_t) ceill(log10l(powl(2.0L, sizeof(long double) * 8 - 1)))) + 2;
-
 static _Thread_local const char *orig;
 static _Thread_local const char *s;
+// set when a schema rejects the document, NULL alone can mean an empty value
+static _Thread_local bool invalid;
+
+// keys of the objects whose shape is being learned, in insertion order
+typedef struct key_stack {
+    const char **keys;
+    size_t *lens;
+    size_t size;
+    size_t capacity;
+} key_stack_t;
+
+static _Thread_local key_stack_t key_stack;
+
+static void push_key(const char *key, size_t len) {
+    if (key_stack.size == key_stack.capacity) {
+        key_stack.capacity = key_stack.capacity ? key_stack.capacity * 2 : 16;
+        key_stack.keys = safe_realloc(key_stack.keys, key_stack.capacity,
+                sizeof(char *));
+        key_stack.lens = safe_realloc(key_stack.lens, key_stack.capacity,
+                sizeof(size_t));
+    }
+
+    key_stack.keys[key_stack.size] = key;
+    key_stack.lens[key_stack.size] = len;
+    key_stack.size++;
+}
 
 static bool is_ws(char c) {
     switch (c) {
@@ -167,12 +191,50 @@ static long double *parse_num() {
 static json_entry_t *json_create_generic(entry_type type, size_t size) {
     json_entry_t *entry = safe_malloc(sizeof(json_entry_t));
     entry->type = type;
-    entry->item = safe_malloc(size);
+    entry->item = size ? safe_malloc(size) : NULL;
 
     return entry;
 }
 
-static json_entry_t *get_value(char outer_end) {
+static entry_type peek_type(char c) {
+    switch (c) {
+        case '{':
+            return OBJECT;
+        case '[':
+            return ARRAY;
+        case '"':
+            return STRING;
+        case 't':
+        case 'f':
+            return BOOL;
+        case 'n':
+            return NIL;
+    }
+
+    return NUMBER;
+}
+
+static bool schema_error(const char *msg) {
+    print_error(msg);
+    invalid = true;
+    return false;
+}
+
+static json_entry_t *create_shaped_obj(hash_shape_t *shape) {
+    json_entry_t *entry = safe_malloc(sizeof(json_entry_t));
+    entry->type = OBJECT;
+    entry->item = hash_init_shaped(shape);
+
+    return entry;
+}
+
+/*
+ * schema is NULL when the value is unconstrained. hint is set for array
+ * elements, it holds the shape of the previous object in the array so that
+ * objects with the same keys in the same order share one key layout.
+ */
+static json_entry_t *get_value(char outer_end,
+        const json_schema_node_t *schema, hash_shape_t **hint) {
 
     while (is_ws(*s)) {
         s++;
@@ -182,15 +244,27 @@ static json_entry_t *get_value(char outer_end) {
         return NULL;
     }
 
+    if (schema && !json_schema_check_type(schema, peek_type(*s))) {
+        schema_error("Schema type mismatch");
+        return NULL;
+    }
+
     json_entry_t *entry = NULL;
+    hash_shape_t *elem_shape = NULL;
     char inner_end = '\0';
 
     switch (*s) {
-        case '{':
-            entry = json_create_obj();
+        case '{':;
+            hash_shape_t *shape = hint ? *hint : NULL;
+            entry = shape ? create_shaped_obj(shape) : json_create_obj();
             json_obj_t *obj = entry->item;
             const char *key_start;
             size_t key_len;
+            const json_schema_node_t *child = NULL;
+            unsigned long long seen = 0;
+            size_t key_index = 0;
+            size_t key_base = key_stack.size;
+            bool learning = hint && !shape;
 
             for (s++; *s; s++) {
                 if (*s == '"') {
@@ -207,17 +281,44 @@ static json_entry_t *get_value(char outer_end) {
                         s++;
                     }
                     s++;
-                    json_entry_t *ent = get_value('}');
+                    if (schema) {
+                        const json_schema_prop_t *prop = json_schema_find_prop(
+                                schema, key_start, key_len);
+                        if (!prop && !schema->additional) {
+                            schema_error("Schema forbids property");
+                            goto FAIL;
+                        }
+                        child = prop ? prop->node : NULL;
+                        seen |= prop ? prop->required_bit : 0;
+                    }
+                    json_entry_t *ent = get_value('}', child, NULL);
                     inner_end = *s;
                     if (!ent) {
-                        if (inner_end != '}') {
+                        if (invalid || inner_end != '}') {
                             print_error("Invalid end");
                             goto FAIL;
                         }
                         break;
+                    } else if (obj->shape && key_index < shape->size
+                            && shape->key_lens[key_index] == key_len
+                            && !memcmp(shape->keys[key_index], key_start,
+                                key_len)) {
+                        hash_insert_shaped(obj, key_index, ent);
                     } else {
+                        if (obj->shape) {
+                            // layout diverged, learn a new one from here
+                            for (size_t i = 0; i < key_index; i++) {
+                                push_key(shape->keys[i], shape->key_lens[i]);
+                            }
+                            hash_unshare(obj);
+                            learning = true;
+                        }
+                        if (learning) {
+                            push_key(key_start, key_len);
+                        }
                         json_insert_obj_entry(obj, key_start, key_len, ent);
                     }
+                    key_index++;
                     if (inner_end == '}') {
                         s++;
                         break;
@@ -232,15 +333,34 @@ static json_entry_t *get_value(char outer_end) {
                     }
                 }
             }
+            if (schema && (seen & schema->required) != schema->required) {
+                schema_error("Schema property missing");
+                goto FAIL;
+            }
+            if (learning && obj->size) {
+                hash_shape_t *learned = hash_shape_create(obj,
+                        (key_stack.keys + key_base),
+                        (key_stack.lens + key_base),
+                        key_stack.size - key_base);
+                if (learned) {
+                    if (*hint) {
+                        hash_shape_release(*hint);
+                    }
+                    hash_shape_retain(learned);
+                    *hint = learned;
+                }
+            }
+            key_stack.size = key_base;
             break;
         case '[':
             entry = json_create_array();
             json_array_t *array = entry->item;
 
             for (s++; *s; s++) {
-                json_entry_t *ent = get_value(']');
+                json_entry_t *ent = get_value(']',
+                        schema ? schema->items : NULL, &elem_shape);
 
-                if (!ent && inner_end == ',') {
+                if (!ent && (invalid || inner_end == ',')) {
                     print_error("Unexpected end");
                     goto FAIL;
                 }
@@ -248,6 +368,10 @@ static json_entry_t *get_value(char outer_end) {
                 if (ent) {
                     json_insert_array_entry(array, ent);
                     free(ent);
+                    if (schema && array->size > schema->max_items) {
+                        schema_error("Schema item count exceeded");
+                        goto FAIL;
+                    }
                 }
 
                 if (*s == ']') {
@@ -260,14 +384,26 @@ static json_entry_t *get_value(char outer_end) {
                     goto FAIL;
                 }
             }
+            if (elem_shape) {
+                hash_shape_release(elem_shape);
+                elem_shape = NULL;
+            }
+            if (schema && array->size < schema->min_items) {
+                schema_error("Schema item count not met");
+                goto FAIL;
+            }
             break;
         case '"':;
             const char *start = (s + sizeof(char));
-            if (validate_string()) {
-                entry = json_create_string(start, s - start - sizeof(char));
-            } else {
+            if (!validate_string()) {
                 goto FAIL;
             }
+            size_t len = s - start - sizeof(char);
+            if (schema && !json_schema_check_string(schema, start, len)) {
+                schema_error("Schema string length mismatch");
+                goto FAIL;
+            }
+            entry = json_create_string(start, len);
             break;
         default:
             if (!strncmp(s, "true", 4)) {
@@ -281,8 +417,12 @@ static json_entry_t *get_value(char outer_end) {
                 s += 4;
             } else {
                 long double *ld = parse_num();
-                if (ld) {
-                    entry = json_create_generic(NUMBER, sizeof(long double));
+                if (ld && schema && !json_schema_check_number(schema, *ld)) {
+                    free(ld);
+                    schema_error("Schema number out of range");
+                    return NULL;
+                } else if (ld) {
+                    entry = json_create_generic(NUMBER, 0);
                     entry->item = ld;
                 } else {
                     print_error("No match");
@@ -306,14 +446,27 @@ static json_entry_t *get_value(char outer_end) {
     return entry;
 
 FAIL:
-    json_destroy(entry);
+    if (elem_shape) {
+        hash_shape_release(elem_shape);
+    }
+    if (entry) {
+        json_destroy(entry);
+    }
     return NULL;
 }
 
 json_entry_t *json_parse(const char *json) {
+    return json_parse_schema(json, NULL);
+}
+
+json_entry_t *json_parse_schema(const char *json,
+        const json_schema_t *schema) {
     orig = json;
     s = json;
-    json_entry_t *entry = get_value('\0');
+    invalid = false;
+    key_stack.size = 0;
+    json_entry_t *entry = get_value('\0', schema ? schema->nodes : NULL,
+            NULL);
 
     if (!entry) {
         fprintf(stderr, "Invalid JSON!\n");
@@ -360,9 +513,29 @@ void json_destroy(json_entry_t *entry) {
     entry = NULL;
 }
 
-static char *stringify_num(double long ld, size_t *len) {
-    char *json = safe_malloc((DEFAULT_NUMBER_LENGTH + 1) * sizeof(char));
-    size_t idx = sprintf(json, "%lld", (long long int) ld);
+size_t json_format_number(long double ld, char *json) {
+    // JSON has no representation for NaN or infinity
+    if (!isfinite(ld)) {
+        strcpy(json, "null");
+        return 4;
+    }
+
+    // the digit loop needs the integer part to fit a long long
+    if (fabsl(ld) >= 0x1p63L) {
+        return sprintf(json, "%.*Lg", LDBL_DIG, ld);
+    }
+
+    size_t idx = 0;
+    if (ld < 0 && ld > -1) {
+        json[idx++] = '-';
+    }
+    idx += sprintf((json + idx), "%lld", (long long int) ld);
+
+    // integers don't need the digit loop
+    if (ld == (long long int) ld) {
+        return idx;
+    }
+
     ld = fabsl(ld);
     ld = (ld - ((long long int) ld)) + powl(10.0L, -LDBL_DIG);
     size_t level = LDBL_DIG - 1;
@@ -387,11 +560,15 @@ static char *stringify_num(double long ld, size_t *len) {
 
     json[idx] = '\0';
 
-    if (idx < DEFAULT_NUMBER_LENGTH) {
-        json = safe_realloc(json, idx, sizeof(char));
-    }
+    return idx;
+}
 
-    *len = idx;
+static char *stringify_num(double long ld, size_t *len) {
+    char buf[JSON_NUMBER_LENGTH];
+    *len = json_format_number(ld, buf);
+
+    char *json = safe_malloc((*len + 1) * sizeof(char));
+    memcpy(json, buf, *len + 1);
 
     return json;
 }
@@ -481,6 +658,196 @@ char *json_stringify(const json_entry_t *entry, size_t *n) {
     return json;
 }
 
+static void clone_into(json_entry_t *dst, const json_entry_t *src);
+
+static void *clone_obj_value(const void *value) {
+    json_entry_t *entry = safe_malloc(sizeof(json_entry_t));
+    clone_into(entry, value);
+
+    return entry;
+}
+
+static void clone_into(json_entry_t *dst, const json_entry_t *src) {
+    json_array_t *arr, *src_arr;
+    size_t len;
+
+    dst->type = src->type;
+    switch (src->type) {
+        case OBJECT:
+            dst->item = hash_clone(src->item, clone_obj_value);
+            break;
+        case ARRAY:
+            src_arr = src->item;
+            arr = safe_malloc(sizeof(json_array_t));
+            arr->size = src_arr->size;
+            arr->capacity = src_arr->size ? src_arr->size : 1;
+            arr->entries = safe_malloc(arr->capacity * sizeof(json_entry_t));
+            for (size_t i = 0; i < arr->size; i++) {
+                clone_into((arr->entries + i), (src_arr->entries + i));
+            }
+            dst->item = arr;
+            break;
+        case STRING:
+            len = strlen(src->item) + 1;
+            dst->item = safe_malloc(len * sizeof(char));
+            memcpy(dst->item, src->item, len);
+            break;
+        case NUMBER:
+            dst->item = safe_malloc(sizeof(long double));
+            memcpy(dst->item, src->item, sizeof(long double));
+            break;
+        case BOOL:
+            dst->item = safe_malloc(sizeof(bool));
+            memcpy(dst->item, src->item, sizeof(bool));
+            break;
+        default:
+            dst->item = NULL;
+            break;
+    }
+}
+
+json_entry_t *json_clone(const json_entry_t *entry) {
+    return clone_obj_value(entry);
+}
+
+// with repeated keys only the member that json_get_obj_entry finds counts
+// only objects that may repeat a key pay for the lookup
+static bool is_visible(const json_obj_t *obj, const entry_t *e,
+        size_t key_hash) {
+    return !obj->repeats
+        || hash_search_hashed(obj, e->key, key_hash) == e->value;
+}
+
+static size_t count_visible(const json_obj_t *obj) {
+    size_t n = 0;
+
+    for (size_t i = 0; i < obj->capacity; i++) {
+        entry_t *e = (obj->entries + i);
+        if (e->key && is_visible(obj, e, hash_key(e->key, strlen(e->key)))) {
+            n++;
+        }
+    }
+
+    return n;
+}
+
+bool json_equal(const json_entry_t *a, const json_entry_t *b) {
+    if (a == b) {
+        return true;
+    } else if (a->type != b->type) {
+        return false;
+    }
+
+    json_obj_t *obj_a, *obj_b;
+    json_array_t *arr_a, *arr_b;
+
+    switch (a->type) {
+        case OBJECT:
+            obj_a = a->item;
+            obj_b = b->item;
+            size_t visible = 0;
+            for (size_t i = 0; i < obj_a->capacity; i++) {
+                entry_t *e = (obj_a->entries + i);
+                if (!e->key) {
+                    continue;
+                }
+
+                size_t key_hash = hash_key(e->key, strlen(e->key));
+                if (!is_visible(obj_a, e, key_hash)) {
+                    continue;
+                }
+
+                visible++;
+                json_entry_t *other = hash_search_hashed(obj_b, e->key,
+                        key_hash);
+                if (!other || !json_equal(e->value, other)) {
+                    return false;
+                }
+            }
+            // every key of a is in b, so b can only have extra members
+            return visible == obj_b->size
+                || (obj_b->repeats && visible == count_visible(obj_b));
+        case ARRAY:
+            arr_a = a->item;
+            arr_b = b->item;
+            if (arr_a->size != arr_b->size) {
+                return false;
+            }
+            for (size_t i = 0; i < arr_a->size; i++) {
+                if (!json_equal((arr_a->entries + i), (arr_b->entries + i))) {
+                    return false;
+                }
+            }
+            return true;
+        case STRING:
+            return !strcmp(a->item, b->item);
+        case NUMBER:
+            return *((long double *) a->item) == *((long double *) b->item);
+        case BOOL:
+            return *((bool *) a->item) == *((bool *) b->item);
+        default:
+            return true;
+    }
+}
+
+// splitmix64 finalizer, spreads the bits of combined hashes
+static size_t mix(unsigned long long h) {
+    h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    h = (h ^ (h >> 27)) * 0x94D049BB133111EBULL;
+
+    return h ^ (h >> 31);
+}
+
+size_t json_hash(const json_entry_t *entry) {
+    size_t h = entry->type;
+    json_obj_t *obj;
+    json_array_t *arr;
+    double d;
+    unsigned long long bits = 0;
+
+    switch (entry->type) {
+        case OBJECT:
+            // members are summed so that slot order doesn't matter
+            obj = entry->item;
+            for (size_t i = 0; i < obj->capacity; i++) {
+                entry_t *e = (obj->entries + i);
+                if (!e->key) {
+                    continue;
+                }
+
+                size_t key_hash = hash_key(e->key, strlen(e->key));
+                if (is_visible(obj, e, key_hash)) {
+                    h += mix(key_hash * 31 + json_hash(e->value));
+                }
+            }
+            break;
+        case ARRAY:
+            arr = entry->item;
+            for (size_t i = 0; i < arr->size; i++) {
+                h = (h * 31) + json_hash(arr->entries + i);
+            }
+            break;
+        case STRING:
+            h += hash_key(entry->item, strlen(entry->item));
+            break;
+        case NUMBER:
+            // long double has padding bytes, hash its value as a double
+            d = *((long double *) entry->item);
+            if (d != 0) {
+                memcpy(&bits, &d, sizeof(double));
+            }
+            h += bits;
+            break;
+        case BOOL:
+            h += *((bool *) entry->item);
+            break;
+        default:
+            break;
+    }
+
+    return mix(h);
+}
+
 static void *json_get_item(const json_entry_t *entry,
         entry_type required_type) {
     if (entry->type != required_type) {
@@ -559,10 +926,7 @@ json_entry_t *json_create_bool(bool b) {
 }
 
 json_entry_t *json_create_null() {
-    json_entry_t *entry = json_create_generic(NIL, 0);
-    entry->item = NULL;
-
-    return entry;
+    return json_create_generic(NIL, 0);
 }
 
 void json_insert_obj_entry(json_obj_t *obj, const char *key, size_t len,
@@ -571,7 +935,10 @@ void json_insert_obj_entry(json_obj_t *obj, const char *key, size_t len,
 }
 
 void json_remove_obj_entry(json_obj_t *obj, const char *key) {
-    free(hash_remove(obj, key));
+    json_entry_t *entry = hash_remove(obj, key);
+    if (entry) {
+        json_destroy(entry);
+    }
 }
 
 void json_insert_array_entry(json_array_t *array, const json_entry_t *entry) {
@@ -592,9 +959,10 @@ void json_remove_array_entry(json_array_t *array, size_t index) {
         return;
     }
 
+    _json_destroy((array->entries + index));
     if (index + 1 != array->size) {
-        memcpy((array->entries + index), (array->entries + index + 1),
-                (array->size - index + 1) * sizeof(json_entry_t));
+        memmove((array->entries + index), (array->entries + index + 1),
+                (array->size - index - 1) * sizeof(json_entry_t));
     }
 
     array->size--;
@@ -607,7 +975,7 @@ void json_remove_array_entry(json_array_t *array, size_t index) {
 }
 
 void json_nullify_entry(json_entry_t *entry) {
+    _json_destroy(entry);
     entry->type = NIL;
-    json_destroy(entry->item);
     entry->item = NULL;
 }
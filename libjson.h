@@ -7,6 +7,9 @@
 
 #include "hashtable.h"
 
+// enough for any number written by json_format_number, including the '\0'
+#define JSON_NUMBER_LENGTH 48
+
 typedef enum entry_type {
     UNKNOWN,
     NIL,
@@ -34,8 +37,23 @@ typedef struct json_array {
 json_entry_t *json_parse(const char *);
 // returned value is heap allocated
 char *json_stringify(const json_entry_t *, size_t *);
+/*
+ * buffer must hold JSON_NUMBER_LENGTH chars, returns the length written;
+ * NaN and infinities, which JSON can't represent, are written as null
+ */
+size_t json_format_number(long double, char *);
 void json_destroy(json_entry_t *);
 
+// deep copy, the returned value is heap allocated
+json_entry_t *json_clone(const json_entry_t *);
+/*
+ * structural equality, object members are compared regardless of order; when
+ * a key repeats only the member json_get_obj_entry returns is compared
+ */
+bool json_equal(const json_entry_t *, const json_entry_t *);
+// consistent with json_equal: equal trees hash equally
+size_t json_hash(const json_entry_t *);
+
 json_obj_t *json_get_obj(const json_entry_t *);
 json_array_t *json_get_array(const json_entry_t *);
 // key must be null terminated